@@ -0,0 +1,31 @@
+#include <cstdlib>
+#include <new>
+#include "allocations.hpp"
+
+std::atomic<unsigned long long> allocations(0);
+std::atomic<unsigned long long> allocatedBytes(0);
+
+void* operator new(size_t size) {
+	++allocations;
+	allocatedBytes += size;
+	void* p = std::malloc(size ? size : 1);
+	if (p == nullptr) {
+		throw std::bad_alloc();
+	}
+	return p;
+}
+void* operator new[](size_t size) {
+	return operator new(size);
+}
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+void operator delete[](void* p) noexcept {
+	std::free(p);
+}
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+void operator delete[](void* p, size_t) noexcept {
+	std::free(p);
+}
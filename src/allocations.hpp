@@ -0,0 +1,14 @@
+#ifndef ALLOCATIONS_HPP
+#define ALLOCATIONS_HPP
+
+// Includes
+#include <atomic>
+
+// Heap allocations made by the process, and the bytes asked for; counted
+// by the replacement operators new and delete in allocations.cpp, which
+// only the benchmark links. They sit in their own translation unit so no
+// caller inlines the free() behind operator delete against an operator new.
+extern std::atomic<unsigned long long> allocations;
+extern std::atomic<unsigned long long> allocatedBytes;
+
+#endif  // ALLOCATIONS_HPP
@@ -0,0 +1,199 @@
+#ifndef ARENA_HPP
+#define ARENA_HPP
+
+// Includes
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <type_traits>
+#include <vector>
+
+const size_t DEFAULT_ARENA_SIZE = 1 << 16;  // Bytes in first arena chunk
+
+/**
+ * Monotonic buffer for per-query temporaries
+ * Allocation bumps a pointer and deallocation is a no-op; everything is
+ * released at once by rewinding to a marker. Chunks are kept across
+ * rewinds, and a full reset merges them into one, so after a few queries
+ * of steady size the arena never touches the system allocator again.
+ */
+class Arena {
+private:
+	typedef struct {
+		char* data;
+		size_t size;
+	} Chunk;
+
+	std::vector<Chunk> chunks;
+	size_t current;    // Chunk being filled
+	size_t offset;     // Bytes used in current chunk
+	size_t used;       // Bytes handed out since last reset
+	size_t highWater;  // Most bytes ever in use at once
+
+	void addChunk(size_t size) {
+		Chunk chunk = { static_cast<char*>(std::malloc(size)), size };
+		if (chunk.data == nullptr) {
+			throw std::bad_alloc();
+		}
+		chunks.push_back(chunk);
+	}
+	void freeChunks() {
+		for (Chunk& chunk : chunks) {
+			std::free(chunk.data);
+		}
+		chunks.clear();
+	}
+
+public:
+	typedef struct {
+		size_t chunk;
+		size_t offset;
+		size_t used;
+	} Marker;
+
+	Arena(size_t initial = DEFAULT_ARENA_SIZE)
+		: current(0), offset(0), used(0), highWater(0) {
+		addChunk(initial);
+	}
+	~Arena() {
+		freeChunks();
+	}
+	Arena(const Arena&) = delete;
+	Arena& operator=(const Arena&) = delete;
+
+	void* allocate(size_t bytes, size_t align) {
+		size_t start = (offset + align - 1) & ~(align - 1);
+		while (start + bytes > chunks[current].size) {
+			// Move on to the next kept chunk, or add one big enough
+			if (current + 1 == chunks.size()) {
+				addChunk(std::max(2 * chunks[current].size, bytes + align));
+			}
+			++current;
+			offset = 0;
+			start = 0;
+		}
+		offset = start + bytes;
+		used += bytes;
+		highWater = std::max(highWater, used);
+		return chunks[current].data + start;
+	}
+	template <typename U>
+	U* allocate(size_t n) {
+		return static_cast<U*>(allocate(n * sizeof(U), alignof(U)));
+	}
+
+	Marker mark() const {
+		Marker m = { current, offset, used };
+		return m;
+	}
+	void release(const Marker& m) {
+		if (m.chunk == 0 && m.offset == 0) {
+			reset();
+			return;
+		}
+		current = m.chunk;
+		offset = m.offset;
+		used = m.used;
+	}
+	void reset() {
+		if (chunks.size() > 1) {
+			// Merge so the next query of this size fits in a single chunk
+			size_t total = 0;
+			for (Chunk& chunk : chunks) {
+				total += chunk.size;
+			}
+			freeChunks();
+			addChunk(total);
+		}
+		current = 0;
+		offset = 0;
+		used = 0;
+	}
+
+	size_t getCapacity() const {
+		size_t total = 0;
+		for (const Chunk& chunk : chunks) {
+			total += chunk.size;
+		}
+		return total;
+	}
+	size_t getUsed() const {
+		return used;
+	}
+	size_t getHighWater() const {
+		return highWater;
+	}
+};
+
+// Releases everything allocated from an arena during the enclosing scope
+class ArenaScope {
+private:
+	Arena& arena;
+	Arena::Marker marker;
+
+public:
+	ArenaScope(Arena& a) : arena(a), marker(a.mark()) {}
+	~ArenaScope() {
+		arena.release(marker);
+	}
+	ArenaScope(const ArenaScope&) = delete;
+	ArenaScope& operator=(const ArenaScope&) = delete;
+};
+
+/**
+ * Standard allocator drawing from an Arena, or from the heap when none is
+ * given (the default), so containers using it behave like ordinary ones
+ * unless a query explicitly binds them to its arena. Copies of a container
+ * always go to the heap, so they can safely outlive the arena scope.
+ */
+template <typename U>
+class ArenaAllocator {
+public:
+	typedef U value_type;
+	typedef std::false_type propagate_on_container_copy_assignment;
+	typedef std::false_type propagate_on_container_move_assignment;
+	typedef std::false_type propagate_on_container_swap;
+
+	Arena* arena;
+
+	ArenaAllocator() noexcept : arena(nullptr) {}
+	explicit ArenaAllocator(Arena* a) noexcept : arena(a) {}
+	template <typename V>
+	ArenaAllocator(const ArenaAllocator<V>& other) noexcept
+		: arena(other.arena) {}
+
+	U* allocate(size_t n) {
+		if (arena != nullptr) {
+			return arena->allocate<U>(n);
+		}
+		return static_cast<U*>(::operator new(n * sizeof(U)));
+	}
+	void deallocate(U* p, size_t) noexcept {
+		if (arena == nullptr) {
+			::operator delete(p);
+		}
+	}
+	ArenaAllocator select_on_container_copy_construction() const {
+		return ArenaAllocator();
+	}
+};
+
+template <typename U, typename V>
+bool operator==(const ArenaAllocator<U>& a, const ArenaAllocator<V>& b) {
+	return a.arena == b.arena;
+}
+
+template <typename U, typename V>
+bool operator!=(const ArenaAllocator<U>& a, const ArenaAllocator<V>& b) {
+	return a.arena != b.arena;
+}
+
+// Arena for temporaries of the query running on this thread
+inline Arena& queryArena() {
+	static thread_local Arena arena;
+	return arena;
+}
+
+#endif  // ARENA_HPP
@@ -0,0 +1,396 @@
+#ifndef ASYNC_HPP
+#define ASYNC_HPP
+
+// Includes
+#include <deque>
+#include <memory>
+#include <queue>
+#include "loco.hpp"
+
+/**
+ * Asynchronous loco(): each query is a resumable state machine that stops
+ * at every row or column probe, so one thread can keep many queries in
+ * flight and overlap their probe latencies. A ProbeSource fetches probes
+ * (in any order, with any latency) and a QueryScheduler picks which query
+ * with a completed probe runs next. Queries explore, count messages and
+ * probes, truncate and solve exactly as loco() does; only b of the local
+ * problem is read synchronously, through the oracle's getB.
+ */
+
+typedef struct {
+	bool isRow;
+	unsigned index;
+} ProbeRequest;
+
+// Fetches probes for suspended queries
+class ProbeSource {
+public:
+	virtual ~ProbeSource() {}
+	// Start fetching a probe into out, which stays valid until completion
+	virtual void submit(unsigned id, ProbeRequest request, SpVec& out) = 0;
+	// Block until at least one submitted probe is complete, appending ids
+	virtual void wait(std::vector<unsigned>& completed) = 0;
+};
+
+// Probes an in-memory oracle at once; the synchronous baseline
+template <typename O>
+class ImmediateSource final : public ProbeSource {
+private:
+	const O& oracle;
+	std::vector<unsigned> done;
+
+public:
+	ImmediateSource(const O& o) : oracle(o) {}
+
+	void submit(unsigned id, ProbeRequest request, SpVec& out) override {
+		if (request.isRow) {
+			oracle.probeRow(request.index, out);
+		} else {
+			oracle.probeCol(request.index, out);
+		}
+		done.push_back(id);
+	}
+	void wait(std::vector<unsigned>& completed) override {
+		completed.insert(completed.end(), done.begin(), done.end());
+		done.clear();
+	}
+};
+
+// Models a slow store: every probe completes a fixed latency after submit
+template <typename O>
+class LatencySource final : public ProbeSource {
+private:
+	typedef std::chrono::steady_clock Clock;
+	typedef struct {
+		Clock::time_point due;
+		unsigned id;
+		ProbeRequest request;
+		SpVec* out;
+	} Pending;
+	struct Later {
+		bool operator()(const Pending& a, const Pending& b) const {
+			return a.due > b.due;
+		}
+	};
+
+	const O& oracle;
+	Clock::duration latency;
+	std::priority_queue<Pending, std::vector<Pending>, Later> pending;
+
+public:
+	LatencySource(const O& o, Clock::duration latency_)
+		: oracle(o), latency(latency_) {}
+
+	void submit(unsigned id, ProbeRequest request, SpVec& out) override {
+		Pending p = { Clock::now() + latency, id, request, &out };
+		pending.push(p);
+	}
+	void wait(std::vector<unsigned>& completed) override {
+		if (pending.empty()) {
+			return;
+		}
+		std::this_thread::sleep_until(pending.top().due);
+		Clock::time_point now = Clock::now();
+		while (!pending.empty() && pending.top().due <= now) {
+			const Pending& p = pending.top();
+			if (p.request.isRow) {
+				oracle.probeRow(p.request.index, *p.out);
+			} else {
+				oracle.probeCol(p.request.index, *p.out);
+			}
+			completed.push_back(p.id);
+			pending.pop();
+		}
+	}
+};
+
+// Orders queries whose probes have completed
+class QueryScheduler {
+public:
+	virtual ~QueryScheduler() {}
+	virtual void ready(unsigned id) = 0;
+	virtual bool next(unsigned& id) = 0;
+};
+
+// Resume queries in the order their probes completed
+class FifoScheduler final : public QueryScheduler {
+private:
+	std::deque<unsigned> queue;
+
+public:
+	void ready(unsigned id) override {
+		queue.push_back(id);
+	}
+	bool next(unsigned& id) override {
+		if (queue.empty()) {
+			return false;
+		}
+		id = queue.front();
+		queue.pop_front();
+		return true;
+	}
+};
+
+// Resume the most recently completed first, keeping its data in cache
+class LifoScheduler final : public QueryScheduler {
+private:
+	std::vector<unsigned> stack;
+
+public:
+	void ready(unsigned id) override {
+		stack.push_back(id);
+	}
+	bool next(unsigned& id) override {
+		if (stack.empty()) {
+			return false;
+		}
+		id = stack.back();
+		stack.pop_back();
+		return true;
+	}
+};
+
+// Storage a slot of locoAsync lends to each query it runs in turn, so a
+// query's state lives in an arena and its probe buffers keep capacity
+struct TaskStorage {
+	Arena arena;
+	SpVec probe;  // Filled by the probe source
+	SpVec row;    // Row being expanded
+};
+
+// One loco() query as a state machine suspended at each probe. Exploration
+// steps through exploreCol() like explore(); the gathered local problem is
+// laid out in the arena, borrowed without a copy and solved on a view
+template <typename O, typename F, typename R>
+class LocoTask {
+private:
+	enum State { ROOT, ROW, COL, GATHER, DONE };
+	typedef std::pair<unsigned, unsigned> Remap;  // (row, local row)
+	typedef std::pair<int, double> Entry;         // (local row, value)
+
+	online alg;
+	const O& oracle;
+	const F& funs;
+	const R& ranks;
+	unsigned budget;
+	TaskStorage& storage;
+	ArenaScope scope;  // Releases the query's state with the task
+	State state;
+	ProbeRequest request;
+	unsigned k;   // Dual variable index of the row being expanded
+	unsigned curr;
+	unsigned pos;  // Next nonzero of row to probe
+	uivector x, y;
+	Remap* remap;  // Local rows sorted by row, once exploration is done
+	std::vector<int, ArenaAllocator<int>> outer;
+	std::vector<Entry, ArenaAllocator<Entry>> entries;
+	LocoSolution local;
+
+	void nextRow() {
+		if (curr < x.size() && !local.truncated) {
+			k = x[curr++];
+			suspend(ROW, true, k);
+		} else {
+			remap = storage.arena.allocate<Remap>(x.size());
+			for (unsigned i = 0; i < x.size(); ++i) {
+				new (remap + i) Remap(x[i], i);
+			}
+			std::sort(remap, remap + x.size());
+			outer.push_back(0);
+			curr = 0;  // Now counts gathered columns
+			nextGather();
+		}
+	}
+	void nextCol() {
+		if (pos < storage.row.nonZeros() && !local.truncated) {
+			suspend(COL, false, storage.row.innerIndexPtr()[pos]);
+		} else {
+			nextRow();
+		}
+	}
+	void nextGather() {
+		if (curr < y.size()) {
+			suspend(GATHER, false, y[curr]);
+		} else {
+			solve();
+		}
+	}
+	void suspend(State s, bool isRow, unsigned index) {
+		state = s;
+		request.isRow = isRow;
+		request.index = index;
+	}
+
+	void gatherCol() {
+		// Keep the entries on local rows, ordered by local row
+		size_t first = entries.size();
+		const Remap* begin = remap;
+		const Remap* end = remap + x.size();
+		for (SpVec::InnerIterator it(storage.probe); it; ++it) {
+			const Remap* found = std::lower_bound(
+				begin, end, Remap((unsigned)it.index(), 0));
+			if (found != end && found->first == (unsigned)it.index()) {
+				entries.push_back(Entry((int)found->second, it.value()));
+			}
+		}
+		std::sort(entries.begin() + first, entries.end());
+		outer.push_back((int)entries.size());
+		++curr;
+	}
+	void solve() {
+		unsigned m = (unsigned)x.size(), n = (unsigned)y.size();
+		Arena& arena = storage.arena;
+		int* inner = arena.allocate<int>(entries.size());
+		double* values = arena.allocate<double>(entries.size());
+		for (unsigned i = 0; i < entries.size(); ++i) {
+			inner[i] = entries[i].first;
+			values[i] = entries[i].second;
+		}
+		DVec b_(m);
+		uivector rows(m, 0, ArenaAllocator<unsigned>(&arena));
+		uivector cols(n, 0, ArenaAllocator<unsigned>(&arena));
+		for (unsigned i = 0; i < m; ++i) {
+			b_(i) = oracle.getB(x[i]);
+			rows[i] = i;
+		}
+		for (unsigned j = 0; j < n; ++j) {
+			cols[j] = j;
+		}
+		Matrix problem = Matrix::borrow(m, n, outer.data(), inner, values,
+										std::move(b_));
+
+		// The view and the kernel draw from this thread's arena as in loco()
+		ArenaScope solveScope(queryArena());
+		fvector restricted = restrictFunctions(funs, y, &queryArena());
+		Eigen::Map<DVec> primals(arena.allocate<double>(n), n);
+		alg(problem.getView(rows, cols), restricted, 1, primals);
+		local.primal = primals(0);
+		state = DONE;
+	}
+
+public:
+	LocoTask(online alg_, const O& o, const F& f, const R& r, unsigned ind,
+			 unsigned budget_, TaskStorage& storage_)
+		: alg(alg_),
+		  oracle(o),
+		  funs(f),
+		  ranks(r),
+		  budget(budget_),
+		  storage(storage_),
+		  scope(storage_.arena),
+		  k(0),
+		  curr(0),
+		  pos(0),
+		  x(ArenaAllocator<unsigned>(&storage_.arena)),
+		  y(ArenaAllocator<unsigned>(&storage_.arena)),
+		  remap(nullptr),
+		  outer(ArenaAllocator<int>(&storage_.arena)),
+		  entries(ArenaAllocator<Entry>(&storage_.arena)) {
+		local.messages = 0;
+		local.truncated = false;
+		local.probes = 0;
+		suspend(ROOT, false, ind);
+	}
+
+	bool isDone() const {
+		return state == DONE;
+	}
+	// Probe the query is waiting for, and where it goes
+	ProbeRequest getRequest() const {
+		return request;
+	}
+	SpVec& getBuffer() {
+		return storage.probe;
+	}
+	// Continue after the requested probe completed, up to the next one
+	void resume() {
+		++local.probes;
+		switch (state) {
+		case ROOT:
+			x.push_back(maxRank(storage.probe, ranks));
+			y.push_back(request.index);  // Column ind, queried by ROOT
+			nextRow();
+			break;
+		case ROW:
+			storage.row.swap(storage.probe);
+			pos = 0;
+			nextCol();
+			break;
+		case COL:
+			exploreCol(storage.probe, storage.row.innerIndexPtr()[pos++], k,
+					   ranks, budget, x, y, local);
+			nextCol();
+			break;
+		case GATHER:
+			gatherCol();
+			nextGather();
+			break;
+		case DONE:
+			break;
+		}
+	}
+	const LocoSolution& getSolution() const {
+		return local;
+	}
+};
+
+// Run queries with up to inFlight of them suspended on probes at once
+template <typename O, typename F, typename R>
+std::vector<LocoSolution> locoAsync(online alg, const O& oracle,
+									const F& funs, const R& ranks,
+									const uivector& queries,
+									ProbeSource& source,
+									QueryScheduler& scheduler,
+									unsigned inFlight,
+									unsigned budget = UNLIMITED) {
+	typedef LocoTask<O, F, R> Task;
+	std::vector<LocoSolution> solutions(queries.size());
+	// Storage outlives the tasks, whose arena scopes release into it
+	std::vector<std::unique_ptr<TaskStorage>> storage(std::max(1u, inFlight));
+	std::vector<std::unique_ptr<Task>> slots(storage.size());
+	std::vector<unsigned> slotQuery(slots.size());
+	unsigned started = 0, finished = 0;
+
+	auto start = [&](unsigned slot) {
+		slots[slot].reset();  // Release the previous query's arena first
+		if (started == queries.size()) {
+			return;
+		}
+		if (!storage[slot]) {
+			storage[slot].reset(new TaskStorage());
+		}
+		slotQuery[slot] = started;
+		slots[slot].reset(new Task(alg, oracle, funs, ranks,
+								   queries[started++], budget,
+								   *storage[slot]));
+		source.submit(slot, slots[slot]->getRequest(),
+					  slots[slot]->getBuffer());
+	};
+	for (unsigned slot = 0; slot < slots.size(); ++slot) {
+		start(slot);
+	}
+
+	std::vector<unsigned> completed;
+	while (finished < queries.size()) {
+		completed.clear();
+		source.wait(completed);
+		for (unsigned slot : completed) {
+			scheduler.ready(slot);
+		}
+		unsigned slot;
+		while (scheduler.next(slot)) {
+			Task& task = *slots[slot];
+			task.resume();
+			if (task.isDone()) {
+				solutions[slotQuery[slot]] = task.getSolution();
+				++finished;
+				start(slot);
+			} else {
+				source.submit(slot, task.getRequest(), task.getBuffer());
+			}
+		}
+	}
+	return solutions;
+}
+
+#endif  // ASYNC_HPP
@@ -0,0 +1,314 @@
+#include <cstdlib>
+#include <fstream>
+#include "allocations.hpp"
+#include "async.hpp"
+#include "build.hpp"
+#include "distributed.hpp"
+#include "generators.hpp"
+#include "memory.hpp"
+#include "pattern.hpp"
+#include "reference.hpp"
+#include "service.hpp"
+#include "trace.hpp"
+
+const unsigned SIZE = 1000;
+const uint64_t DEFAULT_SEED = 1;  // Runs compare on the same instance
+const uint64_t TAG_COSTS = 8;     // Random stream of cost coefficients
+const unsigned BUDGET = 5000;  // Keep hub queries from dominating the run
+
+double elapsed(std::chrono::steady_clock::time_point start) {
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() -
+										 start)
+		.count();
+}
+
+int main(int argc, char* argv[]) {
+	uint64_t seed =
+		argc > 1 ? std::strtoull(argv[1], nullptr, 10) : DEFAULT_SEED;
+	RandomStream costs(seed, TAG_COSTS);
+
+	std::cout << "Generating " << SIZE << "x" << SIZE << " matrix, seed "
+		<< seed << "..." << std::endl;
+	Matrix matrix = Matrix::seeded(SIZE, SIZE, seed);
+	matrix.buildRowIndex();  // Exploration probes rows as often as columns
+	online alg = onlineFractional;
+	fvector funs;
+	for (unsigned i = 0; i < SIZE; ++i) {
+		double c = 0.5 + costs.uniform();
+		funs.push_back([c](double x) { return c * x * x; });
+	}
+	dvector ranks = generateRanks(SIZE, seed);
+
+	// Pick dense or sparse local kernels by what is faster on this machine
+	KernelThresholds t = calibrateKernels();
+	setKernelThresholds(t);
+	std::cout << "Dense kernel up to " << t.maxCells << " cells, density >= "
+		<< t.density << std::endl;
+
+	// Warm up arena and scratch buffers, then measure the steady state
+	for (unsigned i = 0; i < SIZE; ++i) {
+		loco(alg, matrix, funs, ranks, i, BUDGET);
+	}
+
+	// Hardware counters around each query, where the system allows them
+	HardwareCounters hw;
+	Histogram perQuery[NUM_COUNTERS];
+	uint64_t before[NUM_COUNTERS], after[NUM_COUNTERS];
+
+	unsigned long long total = 0;
+	unsigned long long maxQueryBytes = 0;
+	unsigned allocFree = 0;
+	unsigned messages = 0;
+	auto start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < SIZE; ++i) {
+		unsigned long long allocated = allocations;
+		unsigned long long bytes = allocatedBytes;
+		hw.read(before);
+		LocoSolution s = loco(alg, matrix, funs, ranks, i, BUDGET);
+		hw.read(after);
+		unsigned long long count = allocations - allocated;
+		maxQueryBytes = std::max(maxQueryBytes, allocatedBytes - bytes);
+		total += count;
+		allocFree += count == 0;
+		messages += s.messages;
+		for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+			perQuery[c].add(after[c] > before[c] ? after[c] - before[c] : 0);
+		}
+	}
+	double seconds = elapsed(start);
+
+	std::cout << "Queries: " << SIZE << ", messages " << messages << ", "
+		<< seconds / SIZE * 1e6 << " us/query" << std::endl;
+	std::cout << "Allocations: " << total << " (" << (double)total / SIZE
+		<< " per query, " << allocFree << " queries allocation-free, at most "
+		<< maxQueryBytes << " bytes in one query)" << std::endl;
+	std::cout << "Arena high-water mark: " << queryArena().getHighWater()
+		<< " bytes" << std::endl;
+	if (hw.isAvailable()) {
+		std::cout << "Hardware counters per query (mean / max):" << std::endl;
+		for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+			std::cout << "  " << counterName((Counter)c) << ": ";
+			if (hw.isAvailable((Counter)c)) {
+				std::cout << perQuery[c].getSum() / SIZE << " / "
+					<< perQuery[c].getMax() << std::endl;
+			} else {
+				std::cout << "unavailable" << std::endl;
+			}
+		}
+	} else {
+		std::cout << "Hardware counters unavailable" << std::endl;
+	}
+
+	// Same queries exploring through the compressed pattern
+	CompressedOracle compressed(matrix);
+	const CompressedPattern& pattern = compressed.getPattern();
+	start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < SIZE; ++i) {
+		loco(alg, compressed, funs, ranks, i, BUDGET);
+	}
+	seconds = elapsed(start);
+	MatrixMemory stored = matrix.getMemory();
+	std::cout << "Compressed adjacency: " << pattern.getBytes() << " bytes vs "
+		<< pattern.getUncompressedBytes() << ", oracle "
+		<< compressed.getBytes() << " bytes in all vs matrix "
+		<< stored.storage + stored.rhs + stored.degrees + stored.rowMajor
+		<< ", " << seconds / SIZE * 1e6 << " us/query" << std::endl;
+
+	// Whole-matrix throughput on every core
+	resetProfile();
+	setProfileCounters(true);
+	start = std::chrono::steady_clock::now();
+	MatrixSolution s = solve(alg, matrix, funs, ranks, 0, BUDGET);
+	seconds = elapsed(start);
+	std::cout << "solve(): " << SIZE / seconds << " queries/s, "
+		<< s.truncated << " truncated" << std::endl;
+
+	// Per-phase histograms of just these queries (LOCO_PROFILE builds),
+	// taken before any later section adds to them
+	setProfileCounters(false);
+	if (profileEnabled()) {
+		std::ofstream out("bench_profile.json");
+		writeProfileJson(out, collectProfile());
+		std::cout << "Profile written to bench_profile.json" << std::endl;
+	}
+
+	// Quality against a global solve of the same program
+	start = std::chrono::steady_clock::now();
+	ReferenceSolution reference = solveReference(matrix, funs);
+	seconds = elapsed(start);
+	CoverQuality online = evaluateCover(matrix, funs, s.primals);
+	std::cout << "Reference: objective " << reference.objective
+		<< ", lower bound " << reference.lowerBound << ", "
+		<< reference.iterations << " iterations in " << seconds
+		<< " s; solve() ratio " << online.objective / reference.objective
+		<< " (to the bound " << online.objective / reference.lowerBound
+		<< "), " << online.violated << " rows uncovered" << std::endl;
+
+	// The same run traced, keeping the explorations that hit the budget
+	TraceThresholds capped = DEFAULT_TRACE;
+	capped.messages = BUDGET;
+	startTracing(capped);
+	start = std::chrono::steady_clock::now();
+	solve(alg, matrix, funs, ranks, 0, BUDGET);
+	double traced = elapsed(start);
+	stopTracing();
+	std::vector<QueryTraceData> traces = collectTraces();
+	std::ofstream traceOut("bench_trace.json");
+	writeChromeTrace(traceOut, traces);
+	std::cout << "Traced solve(): " << SIZE / traced << " queries/s, "
+		<< traces.size() << " traces kept in bench_trace.json" << std::endl;
+
+	// Cost scenarios solved one by one vs sharing each exploration
+	const unsigned SCENARIOS = 4;
+	std::vector<Scenario> scenarios(SCENARIOS);
+	for (unsigned sc = 0; sc < SCENARIOS; ++sc) {
+		for (unsigned i = 0; i < SIZE; ++i) {
+			double c = 0.5 + costs.uniform();
+			scenarios[sc].funs.push_back([c](double x) { return c * x * x; });
+		}
+	}
+	start = std::chrono::steady_clock::now();
+	for (const Scenario& scenario : scenarios) {
+		solve(alg, matrix, scenario.funs, ranks, 0, BUDGET);
+	}
+	double separate = elapsed(start);
+	start = std::chrono::steady_clock::now();
+	solveScenarios(alg, matrix, scenarios, ranks, 0, BUDGET);
+	seconds = elapsed(start);
+	std::cout << SCENARIOS << " scenarios: " << separate << " s separately, "
+		<< seconds << " s batched" << std::endl;
+
+	// Independent rank repetitions sharing one pool
+	const unsigned REPETITIONS = 3;
+	start = std::chrono::steady_clock::now();
+	RepeatedSolution repeated = solveRepeated(alg, matrix, funs, REPETITIONS,
+											  seed, COMBINE_BEST, 0, BUDGET);
+	seconds = elapsed(start);
+	std::cout << REPETITIONS << " rank repetitions: " << seconds
+		<< " s, messages";
+	for (unsigned messages : repeated.messages) {
+		std::cout << " " << messages;
+	}
+	std::cout << ", best objective " << repeated.objectives[repeated.best]
+		<< std::endl;
+
+	// Same queries as a message protocol between simulated nodes
+	const unsigned SIMULATED = 100, NODES = 4;
+	Cluster cluster(matrix, ranks, NODES);
+	DistributedSolution sum = DistributedSolution();
+	for (unsigned i = 0; i < SIMULATED; ++i) {
+		DistributedSolution d = cluster.query(alg, funs, i);
+		sum.messages += d.messages;
+		sum.wireMessages += d.wireMessages;
+		sum.bytes += d.bytes;
+		sum.rounds += d.rounds;
+		sum.latency += d.latency;
+	}
+	std::cout << "Simulated on " << NODES << " nodes, per query: "
+		<< sum.messages / SIMULATED << " LOCO messages, "
+		<< sum.wireMessages / SIMULATED << " sent, "
+		<< sum.bytes / SIMULATED << " bytes, "
+		<< (double)sum.rounds / SIMULATED << " rounds, "
+		<< sum.latency / SIMULATED * 1e6 << " us" << std::endl;
+
+	// Probes with store latency, one query at a time vs overlapped
+	const unsigned ASYNC_QUERIES = 64;
+	uivector queries(ASYNC_QUERIES);
+	for (unsigned i = 0; i < ASYNC_QUERIES; ++i) {
+		queries[i] = i;
+	}
+	LatencySource<Matrix> slow(matrix, std::chrono::microseconds(50));
+	FifoScheduler fifo;
+	for (unsigned inFlight : { 1u, 64u }) {
+		start = std::chrono::steady_clock::now();
+		locoAsync(alg, matrix, funs, ranks, queries, slow, fifo, inFlight,
+				  BUDGET);
+		seconds = elapsed(start);
+		std::cout << "50 us probes, " << inFlight << " in flight: "
+			<< ASYNC_QUERIES / seconds << " queries/s" << std::endl;
+	}
+
+	// Repeated queries against a cached service with occasional updates
+	const unsigned CACHED_QUERIES = 4000, HOT = 200, UPDATE_EVERY = 100;
+	QueryService service(alg, matrix, funs, ranks, BUDGET, HOT);
+	start = std::chrono::steady_clock::now();
+	for (unsigned i = 0; i < CACHED_QUERIES; ++i) {
+		if (i > 0 && i % UPDATE_EVERY == 0) {
+			std::vector<T> cells;
+			for (unsigned c = 0; c < 5; ++c) {
+				cells.push_back(T((unsigned)(costs() % SIZE),
+								  (unsigned)(costs() % SIZE), costs.uniform()));
+			}
+			service.updateCells(cells);
+		}
+		service.query((unsigned)(costs() % HOT));
+	}
+	seconds = elapsed(start);
+	const SolutionCache& cache = *service.getCache();
+	std::cout << "Cached service: " << CACHED_QUERIES / seconds
+		<< " queries/s, hit rate "
+		<< (double)cache.getHits() / (cache.getHits() + cache.getMisses())
+		<< ", " << cache.getInvalidated() << " invalidated" << std::endl;
+
+	// Skewed and structured families, where exploration and scheduling
+	// behave differently from the near-uniform default
+	const char* families[] = { "power-law", "block", "banded",
+							   "preferential" };
+	for (unsigned f = 0; f < 4; ++f) {
+		start = std::chrono::steady_clock::now();
+		Matrix family = f == 0 ? powerLawMatrix(SIZE, SIZE, 6, 2.2, seed)
+			: f == 1 ? blockMatrix(SIZE, SIZE, 20, 0.1, 0.001, seed)
+			: f == 2 ? bandedMatrix(SIZE, SIZE, 3, seed)
+			: preferentialMatrix(SIZE, SIZE, 6, seed);
+		double generated = elapsed(start);
+		start = std::chrono::steady_clock::now();
+		MatrixSolution fs = solve(alg, family, funs, ranks, 0, BUDGET);
+		seconds = elapsed(start);
+		std::cout << families[f] << ": generated in " << generated * 1e3
+			<< " ms, " << family.getTriplets().size() << " nonzeros, max "
+			<< "column degree " << family.getMaxColDegree() << ", "
+			<< SIZE / seconds << " queries/s, " << fs.truncated << " truncated"
+			<< std::endl;
+	}
+
+	// Memory by component, for sizing machines and catching regressions
+	MatrixMemory held = matrix.getMemory();
+	std::cout << "Memory: matrix " << held.storage << " bytes + b "
+		<< held.rhs << " + degrees " << held.degrees << " + row-major copy "
+		<< held.rowMajor << ", compressed oracle " << compressed.getBytes()
+		<< ", solution " << solutionBytes(s) << ", cache " << cache.getBytes()
+		<< ", query state " << queryStateBytes() << " per thread" << std::endl;
+	std::cout << "Resident: " << residentBytes() << " bytes, peak "
+		<< peakResidentBytes() << std::endl;
+
+	// Bulk construction: Eigen's serial setFromTriplets against buildSparse
+	// on one thread and on every core, then with the CSR copy too
+	const unsigned BULK_SIZE = 100000, BULK_TRIPLETS = 10000000;
+	std::vector<T> bulk;
+	bulk.reserve(BULK_TRIPLETS);
+	for (unsigned i = 0; i < BULK_TRIPLETS; ++i) {
+		bulk.push_back(T((int)(costs() % BULK_SIZE),
+						 (int)(costs() % BULK_SIZE), costs.uniform()));
+	}
+	start = std::chrono::steady_clock::now();
+	SpMat eigenBuilt(BULK_SIZE, BULK_SIZE);
+	eigenBuilt.setFromTriplets(bulk.begin(), bulk.end());
+	double eigenSeconds = elapsed(start);
+	SpMat built;
+	start = std::chrono::steady_clock::now();
+	buildSparse(BULK_SIZE, BULK_SIZE, bulk, built, nullptr, DUPLICATES_SUM, 1);
+	double serialSeconds = elapsed(start);
+	start = std::chrono::steady_clock::now();
+	buildSparse(BULK_SIZE, BULK_SIZE, bulk, built);
+	double parallelSeconds = elapsed(start);
+	SpMatR builtRows;
+	start = std::chrono::steady_clock::now();
+	buildSparse(BULK_SIZE, BULK_SIZE, bulk, built, &builtRows);
+	seconds = elapsed(start);
+	std::cout << BULK_TRIPLETS << " triplets: setFromTriplets " << eigenSeconds
+		<< " s; buildSparse " << serialSeconds << " s on 1 thread ("
+		<< eigenSeconds / serialSeconds << "x), " << parallelSeconds
+		<< " s on " << std::thread::hardware_concurrency() << " threads ("
+		<< eigenSeconds / parallelSeconds << "x), " << seconds
+		<< " s with CSR" << std::endl;
+}
@@ -0,0 +1,306 @@
+#include <atomic>
+#include <thread>
+#include "build.hpp"
+
+// Fewest items worth a thread of their own
+const size_t MIN_ITEMS_PER_THREAD = 1 << 16;
+// Coarse buckets per thread in the first pass of bucketItems()
+const unsigned BUCKETS_PER_THREAD = 64;
+
+// Threads for count items; per-thread counts cover coarse buckets, not
+// keys, so any key range runs on every thread the input can keep busy
+static unsigned buildThreads(unsigned threads, size_t count) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	size_t cap = count / MIN_ITEMS_PER_THREAD;
+	return (unsigned)std::max<size_t>(1, std::min<size_t>(threads, cap));
+}
+
+// Run fn(t) for t in [0, threads), on the calling thread too
+template <typename Fn>
+static void runThreads(unsigned threads, Fn fn) {
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t) {
+		pool.push_back(std::thread(fn, t));
+	}
+	fn(0);
+	for (std::thread& t : pool) {
+		t.join();
+	}
+}
+
+// Start of thread t's share of [0, count)
+static size_t share(size_t count, unsigned t, unsigned threads) {
+	return count * t / threads;
+}
+
+// Counting sort of items item(j), j in [first, last), whose keys all lie
+// in [k0, k1): each goes to place(i, pos) from pos = base on, in order
+// within its key, and outer gets the start of every key in the range
+template <typename Item, typename Key, typename Place>
+static void sortRange(size_t first, size_t last, unsigned k0, unsigned k1,
+					  size_t base, Item item, Key key, Place place,
+					  std::vector<size_t>& counts, std::vector<int>& outer) {
+	counts.assign(k1 - k0, 0);
+	for (size_t j = first; j < last; ++j) {
+		++counts[key(item(j)) - k0];
+	}
+	for (unsigned k = k0; k < k1; ++k) {
+		outer[k] = (int)base;
+		size_t n = counts[k - k0];
+		counts[k - k0] = base;
+		base += n;
+	}
+	for (size_t j = first; j < last; ++j) {
+		size_t i = item(j);
+		place(i, counts[key(i) - k0]++);
+	}
+}
+
+/**
+ * Stable counting sort of items [0, count) by key(i) < keys on threads
+ * outer gets keys + 1 offsets, and place(i, pos) is called once per item
+ * with its position; items of one key keep their input order.
+ * On several threads, a first pass partitions the items into contiguous
+ * ranges of keys: per-thread counts over threads * BUCKETS_PER_THREAD
+ * ranges, a prefix sum and a stable scatter of item indices. Threads then
+ * take ranges as they finish and sort each on its own, so the per-thread
+ * counts stay O(threads * BUCKETS_PER_THREAD) whatever the number of keys.
+ */
+template <typename Key, typename Place>
+static void bucketItems(size_t count, unsigned keys, unsigned threads,
+						Key key, Place place, std::vector<int>& outer) {
+	outer.resize((size_t)keys + 1);
+	outer[keys] = (int)count;
+	std::vector<size_t> counts;
+	if (threads == 1 || keys <= 1) {
+		sortRange(
+			0, count, 0, keys, 0, [](size_t j) { return j; }, key, place,
+			counts, outer);
+		return;
+	}
+
+	// Range b holds keys [firstKey(b), firstKey(b + 1))
+	unsigned ranges = (unsigned)std::min<size_t>(
+		keys, (size_t)threads * BUCKETS_PER_THREAD);
+	auto rangeOf = [&](size_t i) {
+		return (unsigned)((uint64_t)key(i) * ranges / keys);
+	};
+	auto firstKey = [&](unsigned b) {
+		return (unsigned)(((uint64_t)b * keys + ranges - 1) / ranges);
+	};
+
+	// Step 1: Per-thread counts of every range, then a prefix sum over
+	// (range, thread) so each thread has its own slot in every range
+	std::vector<std::vector<size_t>> slots(threads);
+	runThreads(threads, [&](unsigned t) {
+		std::vector<size_t>& mine = slots[t];
+		mine.assign(ranges, 0);
+		for (size_t i = share(count, t, threads);
+			 i < share(count, t + 1, threads); ++i) {
+			++mine[rangeOf(i)];
+		}
+	});
+	std::vector<size_t> rangeStart(ranges + 1);
+	size_t pos = 0;
+	for (unsigned b = 0; b < ranges; ++b) {
+		rangeStart[b] = pos;
+		for (unsigned t = 0; t < threads; ++t) {
+			size_t n = slots[t][b];
+			slots[t][b] = pos;
+			pos += n;
+		}
+	}
+	rangeStart[ranges] = pos;
+
+	// Step 2: Scatter item indices into their ranges, in input order
+	std::vector<unsigned> order(count);
+	runThreads(threads, [&](unsigned t) {
+		std::vector<size_t>& mine = slots[t];
+		for (size_t i = share(count, t, threads);
+			 i < share(count, t + 1, threads); ++i) {
+			order[mine[rangeOf(i)]++] = (unsigned)i;
+		}
+	});
+
+	// Step 3: Sort each range by key where it lies, ranges taken in turn
+	std::atomic<unsigned> next(0);
+	runThreads(threads, [&](unsigned) {
+		std::vector<size_t> mine;
+		for (unsigned b = next++; b < ranges; b = next++) {
+			sortRange(
+				rangeStart[b], rangeStart[b + 1], firstKey(b),
+				firstKey(b + 1), rangeStart[b],
+				[&order](size_t j) { return (size_t)order[j]; }, key, place,
+				mine, outer);
+		}
+	});
+}
+
+// Sort one column by row, keeping input order among equal rows, and merge
+// its duplicates; returns the merged length. Each entry is sorted as one
+// 64-bit key, row then position, so a plain sort keeps input order
+static int mergeColumn(int* rows, double* values, int n,
+					   Duplicates duplicates, std::vector<uint64_t>& line,
+					   std::vector<double>& copy, bool& duplicated) {
+	bool sorted = true;
+	for (int i = 1; i < n && sorted; ++i) {
+		sorted = rows[i] > rows[i - 1];
+	}
+	if (sorted) {
+		return n;  // The usual case: nothing to do
+	}
+	line.clear();
+	for (int i = 0; i < n; ++i) {
+		line.push_back((uint64_t)rows[i] << 32 | (uint32_t)i);
+	}
+	std::sort(line.begin(), line.end());
+	copy.assign(values, values + n);
+	int length = 0;
+	for (uint64_t entry : line) {
+		int row = (int)(entry >> 32);
+		double value = copy[(uint32_t)entry];
+		if (length > 0 && rows[length - 1] == row) {
+			duplicated = true;
+			if (duplicates == DUPLICATES_SUM) {
+				values[length - 1] += value;
+			} else {
+				values[length - 1] = value;
+			}
+		} else {
+			rows[length] = row;
+			values[length] = value;
+			++length;
+		}
+	}
+	return length;
+}
+
+void buildRows(const SpMap& csc, SpMatR& csr, unsigned threads) {
+	if (csc.innerNonZeroPtr() != nullptr) {
+		csr = csc;  // Uncompressed: columns have gaps, so copy in one pass
+		return;
+	}
+	size_t nonZeros = (size_t)csc.nonZeros();
+	unsigned rows = (unsigned)csc.rows(), cols = (unsigned)csc.cols();
+	const int* outer = csc.outerIndexPtr();
+	const int* inner = csc.innerIndexPtr();
+	const double* values = csc.valuePtr();
+
+	// Column of every entry, so any thread can start anywhere
+	unsigned colThreads = buildThreads(threads, nonZeros);
+	std::vector<int> colOf(nonZeros);
+	runThreads(colThreads, [&](unsigned t) {
+		for (size_t c = share(cols, t, colThreads);
+			 c < share(cols, t + 1, colThreads); ++c) {
+			std::fill(colOf.begin() + outer[c], colOf.begin() + outer[c + 1],
+					  (int)c);
+		}
+	});
+
+	csr = SpMatR(rows, cols);
+	csr.resizeNonZeros((Eigen::Index)nonZeros);
+	int* csrInner = csr.innerIndexPtr();
+	double* csrValues = csr.valuePtr();
+	std::vector<int> csrOuter;
+	bucketItems(
+		nonZeros, rows, buildThreads(threads, nonZeros),
+		[&](size_t i) { return (unsigned)inner[i]; },
+		[&](size_t i, size_t pos) {
+			csrInner[pos] = colOf[i];
+			csrValues[pos] = values[i];
+		},
+		csrOuter);
+	std::copy(csrOuter.begin(), csrOuter.end(), csr.outerIndexPtr());
+}
+
+void buildSparse(unsigned r, unsigned c, const std::vector<T>& triplets,
+				 SpMat& csc, SpMatR* csr, Duplicates duplicates,
+				 unsigned threads) {
+	size_t count = triplets.size();
+	if (count > (size_t)std::numeric_limits<int>::max()) {
+		std::cout << "buildSparse ERROR: more than 2^31 - 1 triplets\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	unsigned colThreads = buildThreads(threads, count);
+
+	std::atomic<bool> outOfRange(false);
+	runThreads(colThreads, [&](unsigned t) {
+		bool bad = false;
+		for (size_t i = share(count, t, colThreads);
+			 i < share(count, t + 1, colThreads); ++i) {
+			bad = bad || triplets[i].row() < 0 ||
+				(unsigned)triplets[i].row() >= r || triplets[i].col() < 0 ||
+				(unsigned)triplets[i].col() >= c;
+		}
+		if (bad) {
+			outOfRange = true;
+		}
+	});
+	if (outOfRange) {
+		std::cout << "buildSparse ERROR: triplet outside the matrix\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Step 1: Bucket by column straight into the result's arrays, in input
+	// order within each column
+	csc = SpMat(r, c);
+	csc.resizeNonZeros((Eigen::Index)count);
+	int* rows = csc.innerIndexPtr();
+	double* values = csc.valuePtr();
+	std::vector<int> outer;
+	bucketItems(
+		count, c, colThreads,
+		[&](size_t i) { return (unsigned)triplets[i].col(); },
+		[&](size_t i, size_t pos) {
+			rows[pos] = triplets[i].row();
+			values[pos] = triplets[i].value();
+		},
+		outer);
+
+	// Step 2: Sort and merge each column where it lies
+	std::vector<int> lengths(c);
+	std::vector<char> duplicated(colThreads, 0);
+	runThreads(colThreads, [&](unsigned t) {
+		std::vector<uint64_t> line;
+		std::vector<double> copy;
+		bool found = false;
+		for (size_t col = share(c, t, colThreads);
+			 col < share(c, t + 1, colThreads); ++col) {
+			lengths[col] = mergeColumn(rows + outer[col], values + outer[col],
+									   outer[col + 1] - outer[col],
+									   duplicates, line, copy, found);
+		}
+		duplicated[t] = found;
+	});
+	bool merged = std::find(duplicated.begin(), duplicated.end(), 1) !=
+		duplicated.end();
+	if (duplicates == DUPLICATES_ERROR && merged) {
+		std::cout << "buildSparse ERROR: duplicate triplets\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// Step 3: Close the gaps merged duplicates left, moving columns down
+	int* cscOuter = csc.outerIndexPtr();
+	std::copy(outer.begin(), outer.end(), cscOuter);
+	if (merged) {
+		for (unsigned col = 0; col < c; ++col) {
+			int from = outer[col];
+			cscOuter[col + 1] = cscOuter[col] + lengths[col];
+			std::copy(rows + from, rows + from + lengths[col],
+					  rows + cscOuter[col]);
+			std::copy(values + from, values + from + lengths[col],
+					  values + cscOuter[col]);
+		}
+		csc.resizeNonZeros(cscOuter[c]);
+	}
+
+	if (csr != nullptr) {
+		buildRows(SpMap(r, c, csc.nonZeros(), csc.outerIndexPtr(),
+						csc.innerIndexPtr(), csc.valuePtr()),
+				  *csr, threads);
+	}
+}
@@ -0,0 +1,28 @@
+#ifndef BUILD_HPP
+#define BUILD_HPP
+
+// Includes
+#include "matrix.hpp"
+
+/**
+ * Parallel bulk construction of sparse storage from triplets
+ * A stable counting sort on threads (0: every core): each thread counts
+ * its share of the triplets per range of columns, a scan over those
+ * counts gives every thread its own slot in every range, and the threads
+ * place their triplets without locking, then counting sort the ranges
+ * into columns. Columns are then sorted by row and their duplicates
+ * merged in parallel, in the result's own arrays. O(nnz + c) work plus
+ * O(threads^2) counts, so the thread count does not depend on c; threads
+ * are capped so small inputs run on the calling thread alone. Passing
+ * csr also builds the row-major copy from the same pass, in the same way.
+ */
+void buildSparse(unsigned r, unsigned c, const std::vector<T>& triplets,
+				 SpMat& csc, SpMatR* csr = nullptr,
+				 Duplicates duplicates = DUPLICATES_SUM,
+				 unsigned threads = 0);
+
+// Row-major copy of column-major storage, bucketed by row the same way;
+// O(nnz + r)
+void buildRows(const SpMap& csc, SpMatR& csr, unsigned threads = 0);
+
+#endif  // BUILD_HPP
@@ -0,0 +1,189 @@
+#include <algorithm>
+#include "cache.hpp"
+
+// Sort and remove duplicates
+static void compact(uivector& v) {
+	std::sort(v.begin(), v.end());
+	v.erase(std::unique(v.begin(), v.end()), v.end());
+}
+
+// Hash container estimate: one node per element, one pointer per bucket
+template <typename Map>
+static size_t hashBytes(const Map& map) {
+	return map.size() *
+		(sizeof(typename Map::value_type) + 2 * sizeof(void*)) +
+		map.bucket_count() * sizeof(void*);
+}
+
+static size_t depsBytes(
+	const std::unordered_map<unsigned, std::unordered_set<unsigned>>& deps) {
+	size_t bytes = hashBytes(deps);
+	for (auto& dep : deps) {
+		bytes += hashBytes(dep.second);
+	}
+	return bytes;
+}
+
+SolutionCache::SolutionCache(size_t capacity_)
+	: capacity(std::max((size_t)1, capacity_)),
+	  stamp(0),
+	  hits(0),
+	  misses(0),
+	  evictions(0),
+	  invalidated(0) {}
+
+void SolutionCache::drop(Deps& deps, unsigned key, unsigned ind) {
+	auto found = deps.find(key);
+	if (found != deps.end()) {
+		found->second.erase(ind);
+		if (found->second.empty()) {
+			deps.erase(found);
+		}
+	}
+}
+
+void SolutionCache::erase(Entries::iterator entry) {
+	const Footprint& f = entry->footprint;
+	for (unsigned r : f.rows) {
+		drop(rowDeps, r, entry->ind);
+	}
+	for (unsigned c : f.cols) {
+		drop(colDeps, c, entry->ind);
+	}
+	for (unsigned j : f.funs) {
+		drop(funDeps, j, entry->ind);
+	}
+	byIndex.erase(entry->ind);
+	entries.erase(entry);
+}
+
+void SolutionCache::invalidate(Deps& deps, const uivector& indices) {
+	for (unsigned i : indices) {
+		auto found = deps.find(i);
+		if (found == deps.end()) {
+			continue;
+		}
+		std::unordered_set<unsigned> inds;
+		inds.swap(found->second);
+		deps.erase(found);
+		for (unsigned ind : inds) {
+			auto entry = byIndex.find(ind);
+			if (entry != byIndex.end()) {
+				erase(entry->second);
+				++invalidated;
+			}
+		}
+	}
+}
+
+unsigned long long SolutionCache::getStamp() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return stamp;
+}
+
+bool SolutionCache::lookup(unsigned ind, unsigned long long rankEpoch,
+						   LocoSolution& out) {
+	std::lock_guard<std::mutex> guard(lock);
+	auto found = byIndex.find(ind);
+	if (found == byIndex.end() || found->second->rankEpoch != rankEpoch) {
+		++misses;
+		return false;
+	}
+	entries.splice(entries.begin(), entries, found->second);
+	out = found->second->solution;
+	++hits;
+	return true;
+}
+
+void SolutionCache::insert(unsigned ind, unsigned long long rankEpoch,
+						   const LocoSolution& solution, Footprint footprint,
+						   unsigned long long stamp_) {
+	compact(footprint.rows);
+	compact(footprint.cols);
+	compact(footprint.funs);
+
+	std::lock_guard<std::mutex> guard(lock);
+	if (stamp_ != stamp) {
+		return;  // Computed from state that has since changed
+	}
+	auto found = byIndex.find(ind);
+	if (found != byIndex.end()) {
+		erase(found->second);
+	}
+	if (entries.size() >= capacity) {
+		erase(std::prev(entries.end()));
+		++evictions;
+	}
+
+	Entry entry = { ind, rankEpoch, solution, std::move(footprint) };
+	entries.push_front(std::move(entry));
+	byIndex[ind] = entries.begin();
+	const Footprint& f = entries.front().footprint;
+	for (unsigned r : f.rows) {
+		rowDeps[r].insert(ind);
+	}
+	for (unsigned c : f.cols) {
+		colDeps[c].insert(ind);
+	}
+	for (unsigned j : f.funs) {
+		funDeps[j].insert(ind);
+	}
+}
+
+void SolutionCache::invalidate(const uivector& rows, const uivector& cols,
+							   const uivector& funs) {
+	std::lock_guard<std::mutex> guard(lock);
+	++stamp;
+	invalidate(rowDeps, rows);
+	invalidate(colDeps, cols);
+	invalidate(funDeps, funs);
+}
+
+void SolutionCache::clear() {
+	std::lock_guard<std::mutex> guard(lock);
+	++stamp;
+	invalidated += entries.size();
+	entries.clear();
+	byIndex.clear();
+	rowDeps.clear();
+	colDeps.clear();
+	funDeps.clear();
+}
+
+size_t SolutionCache::getSize() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return entries.size();
+}
+
+unsigned long long SolutionCache::getHits() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return hits;
+}
+
+unsigned long long SolutionCache::getMisses() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return misses;
+}
+
+unsigned long long SolutionCache::getEvictions() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return evictions;
+}
+
+unsigned long long SolutionCache::getInvalidated() const {
+	std::lock_guard<std::mutex> guard(lock);
+	return invalidated;
+}
+
+size_t SolutionCache::getBytes() const {
+	std::lock_guard<std::mutex> guard(lock);
+	size_t bytes = hashBytes(byIndex) + depsBytes(rowDeps) +
+		depsBytes(colDeps) + depsBytes(funDeps);
+	for (const Entry& entry : entries) {
+		const Footprint& f = entry.footprint;
+		bytes += sizeof(Entry) + 2 * sizeof(void*) +
+			(f.rows.capacity() + f.cols.capacity() + f.funs.capacity()) *
+			sizeof(unsigned);
+	}
+	return bytes;
+}
@@ -0,0 +1,142 @@
+#ifndef CACHE_HPP
+#define CACHE_HPP
+
+// Includes
+#include <list>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include "loco.hpp"
+
+// Everything a loco() query read: rows and columns probed, and the cost
+// functions of its local problem
+typedef struct {
+	uivector rows;
+	uivector cols;
+	uivector funs;
+} Footprint;
+
+// Records the footprint of queries run through it
+template <typename O>
+class FootprintRecorder final : public Oracle {
+private:
+	const O& oracle;
+	Footprint& footprint;
+
+public:
+	FootprintRecorder(const O& o, Footprint& f) : oracle(o), footprint(f) {}
+
+	unsigned getRows() const override {
+		return oracle.getRows();
+	}
+	unsigned getCols() const override {
+		return oracle.getCols();
+	}
+	SpVec getRow(unsigned r) const override {
+		footprint.rows.push_back(r);
+		return oracle.getRow(r);
+	}
+	SpVec getCol(unsigned c) const override {
+		footprint.cols.push_back(c);
+		return oracle.getCol(c);
+	}
+	double getB(unsigned r) const override {
+		return oracle.getB(r);
+	}
+	void probeRow(unsigned r, SpVec& out) const override {
+		footprint.rows.push_back(r);
+		oracle.probeRow(r, out);
+	}
+	void probeCol(unsigned c, SpVec& out) const override {
+		footprint.cols.push_back(c);
+		oracle.probeCol(c, out);
+	}
+
+	const O& getOracle() const {
+		return oracle;
+	}
+	Footprint& getFootprint() const {
+		return footprint;
+	}
+};
+
+template <typename O>
+void probeRowPattern(const FootprintRecorder<O>& recorder, unsigned r,
+					 SpVec& out) {
+	recorder.getFootprint().rows.push_back(r);
+	probeRowPattern(recorder.getOracle(), r, out);
+}
+
+template <typename O>
+void probeColPattern(const FootprintRecorder<O>& recorder, unsigned c,
+					 SpVec& out) {
+	recorder.getFootprint().cols.push_back(c);
+	probeColPattern(recorder.getOracle(), c, out);
+}
+
+template <typename O, typename Fn>
+void viewSubmatrix(const FootprintRecorder<O>& recorder,
+				   const uivector& rows_, const uivector& cols_, Fn fn) {
+	Footprint& footprint = recorder.getFootprint();
+	footprint.cols.insert(footprint.cols.end(), cols_.begin(), cols_.end());
+	footprint.funs.insert(footprint.funs.end(), cols_.begin(), cols_.end());
+	viewSubmatrix(recorder.getOracle(), rows_, cols_, fn);
+}
+
+/**
+ * Bounded, thread-safe cache of loco() solutions, one per primal index
+ * An entry is valid for the rank epoch it was computed under, until a row,
+ * column or cost function in its footprint is invalidated; the least
+ * recently used entry is evicted when full. Queries take a stamp before
+ * reading the problem state and pass it to insert(), which drops the
+ * entry if anything was invalidated in between, so a result computed
+ * from a state an update has already replaced is never stored.
+ */
+class SolutionCache {
+private:
+	typedef struct {
+		unsigned ind;
+		unsigned long long rankEpoch;
+		LocoSolution solution;
+		Footprint footprint;
+	} Entry;
+	typedef std::list<Entry> Entries;  // Most recently used first
+	typedef std::unordered_map<unsigned, std::unordered_set<unsigned>> Deps;
+
+	size_t capacity;
+	mutable std::mutex lock;
+	Entries entries;
+	std::unordered_map<unsigned, Entries::iterator> byIndex;
+	Deps rowDeps, colDeps, funDeps;  // Primal indices depending on each
+	unsigned long long stamp;        // Invalidations so far
+	unsigned long long hits, misses, evictions, invalidated;
+
+	static void drop(Deps& deps, unsigned key, unsigned ind);
+	void erase(Entries::iterator entry);
+	void invalidate(Deps& deps, const uivector& indices);
+
+public:
+	SolutionCache(size_t capacity_);
+
+	unsigned long long getStamp() const;
+	bool lookup(unsigned ind, unsigned long long rankEpoch, LocoSolution& out);
+	void insert(unsigned ind, unsigned long long rankEpoch,
+				const LocoSolution& solution, Footprint footprint,
+				unsigned long long stamp_);
+
+	// Drop entries depending on any of the given rows, columns or functions
+	void invalidate(const uivector& rows, const uivector& cols,
+					const uivector& funs);
+	void clear();
+
+	size_t getSize() const;
+	unsigned long long getHits() const;
+	unsigned long long getMisses() const;
+	unsigned long long getEvictions() const;
+	unsigned long long getInvalidated() const;
+	// Estimated bytes of entries, footprints and indices, node overheads
+	// included
+	size_t getBytes() const;
+};
+
+#endif  // CACHE_HPP
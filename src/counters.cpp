@@ -0,0 +1,94 @@
+#include "counters.hpp"
+#ifdef __linux__
+#include <cstring>
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+const char* COUNTER_NAMES[NUM_COUNTERS] = { "cycles", "instructions",
+											"llcMisses", "branchMisses",
+											"dtlbMisses" };
+
+const char* counterName(Counter c) {
+	return COUNTER_NAMES[c];
+}
+
+#ifdef __linux__
+int openCounter(uint32_t type, uint64_t config) {
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = type;
+	attr.config = config;
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format =
+		PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+	// This thread, any CPU, no group
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+}
+
+HardwareCounters::HardwareCounters() {
+	fds[COUNTER_CYCLES] =
+		openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES);
+	fds[COUNTER_INSTRUCTIONS] =
+		openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS);
+	fds[COUNTER_LLC_MISSES] =
+		openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+	fds[COUNTER_BRANCH_MISSES] =
+		openCounter(PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES);
+	fds[COUNTER_DTLB_MISSES] = openCounter(
+		PERF_TYPE_HW_CACHE,
+		PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+			(PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+}
+
+HardwareCounters::~HardwareCounters() {
+	for (int fd : fds) {
+		if (fd >= 0) {
+			close(fd);
+		}
+	}
+}
+
+void HardwareCounters::read(uint64_t values[NUM_COUNTERS]) const {
+	for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+		values[c] = 0;
+		uint64_t data[3];  // Value, time enabled, time running
+		if (fds[c] < 0 || ::read(fds[c], data, sizeof(data)) != sizeof(data)) {
+			continue;
+		}
+		if (data[2] > 0 && data[2] < data[1]) {
+			// Multiplexed: extrapolate to the whole enabled time
+			values[c] = (uint64_t)((double)data[0] * data[1] / data[2]);
+		} else {
+			values[c] = data[0];
+		}
+	}
+}
+#else
+HardwareCounters::HardwareCounters() {
+	for (int& fd : fds) {
+		fd = -1;
+	}
+}
+
+HardwareCounters::~HardwareCounters() {}
+
+void HardwareCounters::read(uint64_t values[NUM_COUNTERS]) const {
+	for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+		values[c] = 0;
+	}
+}
+#endif
+
+bool HardwareCounters::isAvailable() const {
+	for (int fd : fds) {
+		if (fd >= 0) {
+			return true;
+		}
+	}
+	return false;
+}
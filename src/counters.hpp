@@ -0,0 +1,45 @@
+#ifndef COUNTERS_HPP
+#define COUNTERS_HPP
+
+// Includes
+#include <cstdint>
+
+// Hardware events counted for the calling thread
+enum Counter {
+	COUNTER_CYCLES,
+	COUNTER_INSTRUCTIONS,
+	COUNTER_LLC_MISSES,
+	COUNTER_BRANCH_MISSES,
+	COUNTER_DTLB_MISSES,
+	NUM_COUNTERS
+};
+
+const char* counterName(Counter c);
+
+/**
+ * Hardware performance counters of the calling thread, user space only
+ * Uses perf_event_open on Linux. Each event is opened on its own, so an
+ * event the CPU, kernel or container does not allow just reads as zero
+ * and the others still work; elsewhere nothing is available. Counts are
+ * scaled up when the kernel multiplexes events. Read only from the thread
+ * that created the object.
+ */
+class HardwareCounters {
+private:
+	int fds[NUM_COUNTERS];
+
+public:
+	HardwareCounters();
+	~HardwareCounters();
+	HardwareCounters(const HardwareCounters&) = delete;
+	HardwareCounters& operator=(const HardwareCounters&) = delete;
+
+	bool isAvailable(Counter c) const {
+		return fds[c] >= 0;
+	}
+	bool isAvailable() const;
+	// Counts since creation, zero for unavailable events
+	void read(uint64_t values[NUM_COUNTERS]) const;
+};
+
+#endif  // COUNTERS_HPP
@@ -0,0 +1,264 @@
+#include <unordered_map>
+#include <unordered_set>
+#include "distributed.hpp"
+
+size_t wireSize(const Cluster::Message& m) {
+	// Type byte, three indices and a value, then counted (row, value) pairs
+	size_t size = 1 + 3 * sizeof(unsigned) + sizeof(double);
+	if (m.type == Cluster::COLUMN) {
+		size += sizeof(unsigned) +
+			m.entries.size() * (sizeof(unsigned) + sizeof(double));
+	}
+	return size;
+}
+
+Cluster::Cluster(const Matrix& m, const dvector& ranks_, unsigned workers_)
+	: matrix(m),
+	  ranks(ranks_),
+	  numWorkers(std::max(1u, workers_)),
+	  wireMessages(0),
+	  bytes(0) {
+	if (ranks.size() != matrix.getRows()) {
+		std::cout << "Cluster ERROR: ranks and matrix rows different sizes\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	for (unsigned i = 0; i <= numWorkers; ++i) {
+		inboxes.push_back(std::unique_ptr<Inbox>(new Inbox()));
+	}
+	for (unsigned i = 0; i < numWorkers; ++i) {
+		workers.push_back(std::thread(&Cluster::work, this, i));
+	}
+}
+
+Cluster::~Cluster() {
+	for (unsigned i = 0; i < numWorkers; ++i) {
+		Message stop = Message();
+		stop.type = STOP;
+		send(i, stop);
+	}
+	for (std::thread& t : workers) {
+		t.join();
+	}
+}
+
+void Cluster::send(unsigned to, Message m) {
+	++wireMessages;
+	bytes += wireSize(m);
+	Inbox& inbox = *inboxes[to];
+	{
+		std::lock_guard<std::mutex> guard(inbox.lock);
+		inbox.queue.push_back(std::move(m));
+	}
+	inbox.ready.notify_one();
+}
+
+Cluster::Message Cluster::receive(unsigned at) {
+	Inbox& inbox = *inboxes[at];
+	std::unique_lock<std::mutex> guard(inbox.lock);
+	inbox.ready.wait(guard, [&inbox]() { return !inbox.queue.empty(); });
+	Message m = std::move(inbox.queue.front());
+	inbox.queue.pop_front();
+	return m;
+}
+
+void Cluster::work(unsigned id) {
+	unsigned coordinator = numWorkers;
+	SpVec line;
+	while (true) {
+		Message m = receive(id);
+		Message reply = Message();
+		reply.node = m.node;
+		switch (m.type) {
+		case ROOT:  // Dual of highest rank in column m.node
+			matrix.probeCol(m.node, line);
+			reply.type = ROOTED;
+			reply.node = maxRank(line, ranks);
+			send(coordinator, reply);
+			break;
+		case EXPAND:  // Row m.node probes each of its columns
+			matrix.probeRow(m.node, line);
+			reply.type = EXPANDED;
+			reply.other = (unsigned)line.nonZeros();
+			send(coordinator, reply);
+			for (SpVec::InnerIterator it(line); it; ++it) {
+				Message probe = Message();
+				probe.type = PROBE;
+				probe.node = (unsigned)it.index();
+				probe.from = m.node;
+				send(owner(probe.node), probe);
+			}
+			break;
+		case PROBE:  // Column m.node reports each of its rows
+			matrix.probeCol(m.node, line);
+			for (SpVec::InnerIterator it(line); it; ++it) {
+				Message visit = Message();
+				visit.type = VISIT;
+				visit.node = (unsigned)it.index();
+				visit.from = m.from;
+				visit.other = m.node;
+				send(coordinator, visit);
+			}
+			reply.type = PROBED;
+			send(coordinator, reply);  // After the VISITs on the same queue
+			break;
+		case GATHER:
+			matrix.probeCol(m.node, line);
+			reply.type = COLUMN;
+			for (SpVec::InnerIterator it(line); it; ++it) {
+				reply.entries.push_back(
+					std::make_pair((unsigned)it.index(), it.value()));
+			}
+			send(coordinator, reply);
+			break;
+		case GATHER_B:
+			reply.type = B;
+			reply.value = matrix.getB(m.node);
+			send(coordinator, reply);
+			break;
+		case STOP:
+			return;
+		default:
+			std::cout << "Cluster ERROR: worker received reply message\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+}
+
+DistributedSolution Cluster::query(online alg, const fvector& funs,
+								   unsigned ind) {
+	std::lock_guard<std::mutex> guard(queryLock);
+	unsigned coordinator = numWorkers;
+	unsigned long long wireBefore = wireMessages, bytesBefore = bytes;
+	auto start = std::chrono::steady_clock::now();
+
+	DistributedSolution s;
+	s.messages = 0;
+	s.rounds = 1;
+
+	// Round 1: the owner of column ind picks the root
+	Message m = Message();
+	m.type = ROOT;
+	m.node = ind;
+	send(owner(ind), m);
+	uivector x, y;
+	x.push_back(receive(coordinator).node);
+	y.push_back(ind);
+	std::unordered_map<unsigned, unsigned> inX;  // Queue position in x
+	std::unordered_set<unsigned> inY;
+	inX[x[0]] = 0;
+	inY.insert(ind);
+
+	// One round per BFS level
+	unsigned curr = 0;
+	while (curr < x.size()) {
+		unsigned end = (unsigned)x.size();
+		for (unsigned i = curr; i < end; ++i) {
+			m = Message();
+			m.type = EXPAND;
+			m.node = x[i];
+			send(owner(x[i]), m);
+		}
+		++s.rounds;
+
+		unsigned expanded = 0, probes = 0, probed = 0;
+		std::vector<Message> visits;
+		while (expanded < end - curr || probed < probes) {
+			m = receive(coordinator);
+			if (m.type == EXPANDED) {
+				++expanded;
+				probes += m.other;
+			} else if (m.type == VISIT) {
+				visits.push_back(std::move(m));
+			} else if (m.type == PROBED) {
+				++probed;
+			}
+		}
+
+		// Replay the level in the order loco() walks it
+		std::sort(visits.begin(), visits.end(),
+				  [&inX](const Message& a, const Message& b) {
+					  unsigned pa = inX.at(a.from), pb = inX.at(b.from);
+					  if (pa != pb) {
+						  return pa < pb;
+					  }
+					  return a.other != b.other ? a.other < b.other
+												: a.node < b.node;
+				  });
+		for (const Message& v : visits) {
+			++s.messages;
+			if (inY.insert(v.other).second) {
+				y.push_back(v.other);
+			}
+			if (ranks[v.node] < ranks[v.from] && inX.count(v.node) == 0) {
+				inX[v.node] = (unsigned)x.size();
+				x.push_back(v.node);
+			}
+		}
+		curr = end;
+	}
+
+	// Final round: gather the local problem on X_k x Y_k from its owners
+	++s.rounds;
+	for (unsigned c : y) {
+		m = Message();
+		m.type = GATHER;
+		m.node = c;
+		send(owner(c), m);
+	}
+	for (unsigned r : x) {
+		m = Message();
+		m.type = GATHER_B;
+		m.node = r;
+		send(owner(r), m);
+	}
+	std::unordered_map<unsigned, unsigned> localRow;
+	for (unsigned i = 0; i < x.size(); ++i) {
+		localRow[x[i]] = i;
+	}
+	std::unordered_map<unsigned, Message> columns;
+	DVec b_(x.size());
+	for (size_t replies = x.size() + y.size(); replies > 0; --replies) {
+		m = receive(coordinator);
+		if (m.type == COLUMN) {
+			unsigned c = m.node;
+			columns[c] = std::move(m);
+		} else {
+			b_(localRow[m.node]) = m.value;
+		}
+	}
+	std::vector<T> triplets;
+	for (unsigned j = 0; j < y.size(); ++j) {
+		for (auto& entry : columns[y[j]].entries) {
+			auto row = localRow.find(entry.first);
+			if (row != localRow.end()) {
+				triplets.push_back(T(row->second, j, entry.second));
+			}
+		}
+	}
+	Matrix local((unsigned)x.size(), (unsigned)y.size(), triplets, b_);
+
+	// Solve locally at the coordinator
+	uivector rows(x.size()), cols(y.size());
+	for (unsigned i = 0; i < rows.size(); ++i) {
+		rows[i] = i;
+	}
+	for (unsigned j = 0; j < cols.size(); ++j) {
+		cols[j] = j;
+	}
+	DVec primals(y.size());
+	{
+		ArenaScope scope(queryArena());
+		alg(local.getView(rows, cols), restrictFunctions(funs, y), 1,
+			primals);
+	}
+	s.primal = primals(0);
+
+	s.wireMessages = wireMessages - wireBefore;
+	s.bytes = bytes - bytesBefore;
+	s.latency = std::chrono::duration<double>(
+					std::chrono::steady_clock::now() - start)
+					.count();
+	return s;
+}
@@ -0,0 +1,88 @@
+#ifndef DISTRIBUTED_HPP
+#define DISTRIBUTED_HPP
+
+// Includes
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "loco.hpp"
+
+typedef struct {
+	double primal;
+	unsigned messages;                // LOCO messages, as loco() counts them
+	unsigned long long wireMessages;  // Every message sent, control included
+	unsigned long long bytes;         // Encoded size of every message sent
+	unsigned rounds;                  // Communication rounds of the query
+	double latency;                   // Wall-clock seconds for the query
+} DistributedSolution;
+
+/**
+ * Simulated deployment of LOCO: rows and columns of a Matrix are split
+ * across worker threads that only communicate through in-memory queues.
+ * A query runs on the calling thread as coordinator and explores X_k and
+ * Y_k as a message protocol, one BFS level per round:
+ *
+ *      EXPAND k      coordinator -> owner of row k
+ *      PROBE k, c    row owner   -> owner of column c, for c in row k
+ *      VISIT k, c, r column owner -> coordinator, for r in column c
+ *                    (one LOCO message each)
+ *
+ * followed by a round gathering the local problem from its owners. VISITs
+ * of a level are replayed in sequential BFS order, so the query explores
+ * exactly what loco() does and returns the same primal; exploration
+ * budgets are not simulated. Workers read the shared Matrix only for the
+ * rows and columns they own. Queries run one at a time.
+ */
+class Cluster {
+public:
+	enum Type { ROOT, ROOTED, EXPAND, EXPANDED, PROBE, VISIT, PROBED,
+				GATHER, COLUMN, GATHER_B, B, STOP };
+	typedef struct {
+		Type type;
+		unsigned node;   // Row or column the message is about
+		unsigned from;   // Row being expanded, for PROBE and VISIT
+		unsigned other;  // Column probed for VISIT, count for EXPANDED
+		double value;
+		std::vector<std::pair<unsigned, double>> entries;  // COLUMN only
+	} Message;
+
+private:
+	typedef struct {
+		std::mutex lock;
+		std::condition_variable ready;
+		std::deque<Message> queue;
+	} Inbox;
+
+	const Matrix& matrix;
+	dvector ranks;
+	unsigned numWorkers;
+	std::vector<std::unique_ptr<Inbox>> inboxes;  // Workers, then coordinator
+	std::vector<std::thread> workers;
+	std::mutex queryLock;
+	std::atomic<unsigned long long> wireMessages;
+	std::atomic<unsigned long long> bytes;
+
+	unsigned owner(unsigned node) const {
+		return node % numWorkers;
+	}
+	void send(unsigned to, Message m);
+	Message receive(unsigned at);
+	void work(unsigned id);
+
+public:
+	Cluster(const Matrix& m, const dvector& ranks_, unsigned workers_);
+	~Cluster();
+	Cluster(const Cluster&) = delete;
+	Cluster& operator=(const Cluster&) = delete;
+
+	DistributedSolution query(online alg, const fvector& funs, unsigned ind);
+	unsigned getWorkers() const {
+		return numWorkers;
+	}
+};
+
+// Encoded size of a message on the wire
+size_t wireSize(const Cluster::Message& m);
+
+#endif  // DISTRIBUTED_HPP
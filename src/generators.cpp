@@ -0,0 +1,287 @@
+#include <cmath>
+#include <functional>
+#include <thread>
+#include "generators.hpp"
+
+// Tags separating the random streams derived from one seed
+const uint64_t TAG_VALUE = 1;
+const uint64_t TAG_ROWS = 2;
+const uint64_t TAG_ORDER = 3;  // Row and column orders of powerLawMatrix
+const uint64_t TAG_B = 7;
+
+// Rows drawn for one column, in any order and possibly repeated
+typedef std::function<void(unsigned col, RandomStream& draws,
+						   std::vector<int>& rows)>
+	ColumnFn;
+
+// Stream of column c, disjoint from every other column's
+static RandomStream columnStream(uint64_t seed, unsigned c) {
+	return RandomStream(seed, TAG_ROWS, (uint64_t)c << 32);
+}
+
+// Draw every column on threads, then assemble values, norms and b
+static Matrix buildColumns(unsigned r, unsigned c, uint64_t seed,
+						   unsigned threads, double noise, ColumnFn fn) {
+	if (r == 0 || c == 0) {
+		std::cout << "buildColumns ERROR: empty matrix\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min(threads, c);
+
+	// Each thread fills a contiguous range of columns into its own arrays
+	typedef struct {
+		std::vector<int> outer;  // Offsets into inner, one past each column
+		std::vector<int> inner;
+		std::vector<double> values;
+	} Part;
+	std::vector<Part> parts(threads);
+	auto worker = [&](unsigned t) {
+		Part& part = parts[t];
+		std::vector<int> rows;
+		for (unsigned col = (unsigned)((uint64_t)c * t / threads);
+			 col < (uint64_t)c * (t + 1) / threads; ++col) {
+			RandomStream draws = columnStream(seed, col);
+			rows.clear();
+			fn(col, draws, rows);
+			std::sort(rows.begin(), rows.end());
+			rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
+			double norm = 0;
+			size_t begin = part.values.size();
+			for (int row : rows) {
+				double value = toUniform(hashKey(seed, TAG_VALUE, col, row));
+				part.inner.push_back(row);
+				part.values.push_back(value);
+				norm += value * value;
+			}
+			norm = std::sqrt(norm);
+			for (size_t i = begin; i < part.values.size() && norm > 0; ++i) {
+				part.values[i] /= norm;
+			}
+			part.outer.push_back((int)part.inner.size());
+		}
+	};
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t) {
+		pool.push_back(std::thread(worker, t));
+	}
+	worker(0);
+	for (std::thread& t : pool) {
+		t.join();
+	}
+
+	std::vector<int> outer(1, 0), inner;
+	std::vector<double> values;
+	for (Part& part : parts) {
+		int base = (int)inner.size();
+		for (int end : part.outer) {
+			outer.push_back(base + end);
+		}
+		inner.insert(inner.end(), part.inner.begin(), part.inner.end());
+		values.insert(values.end(), part.values.begin(), part.values.end());
+		Part().inner.swap(part.inner);  // Free as we go
+		Part().values.swap(part.values);
+	}
+
+	// b = A u + noise v, with u, v uniform in [-1, 1)
+	DVec b(r);
+	for (unsigned row = 0; row < r; ++row) {
+		b(row) = noise * (2 * toUniform(hashKey(seed, TAG_B, 0, row)) - 1);
+	}
+	for (unsigned col = 0; col < c; ++col) {
+		double u = 2 * toUniform(hashKey(seed, TAG_B, 1, col)) - 1;
+		for (int i = outer[col]; i < outer[col + 1]; ++i) {
+			b(inner[i]) += values[i] * u;
+		}
+	}
+	return Matrix::fromCompressed(r, c, outer.data(), inner.data(),
+								  values.data(), b);
+}
+
+// Rows of [lo, hi) each kept with probability p, by geometric skips
+static void bernoulliRows(unsigned lo, unsigned hi, double p,
+						  RandomStream& draws, std::vector<int>& rows) {
+	if (p <= 0 || lo >= hi) {
+		return;
+	}
+	if (p >= 1) {
+		for (unsigned row = lo; row < hi; ++row) {
+			rows.push_back((int)row);
+		}
+		return;
+	}
+	double scale = 1 / std::log(1 - p);
+	for (double row = lo;;) {
+		row += std::floor(std::log(1 - draws.uniform()) * scale);
+		if (row >= hi) {
+			break;
+		}
+		rows.push_back((int)row);
+		++row;
+	}
+}
+
+// Vose alias table: O(1) draws from a fixed discrete distribution
+class AliasTable {
+private:
+	std::vector<double> prob;
+	std::vector<unsigned> alias;
+
+public:
+	AliasTable(const std::vector<double>& weights)
+		: prob(weights.size()), alias(weights.size()) {
+		unsigned n = (unsigned)weights.size();
+		double total = 0;
+		for (double w : weights) {
+			total += w;
+		}
+		std::vector<unsigned> small, large;
+		for (unsigned i = 0; i < n; ++i) {
+			prob[i] = weights[i] * n / total;
+			(prob[i] < 1 ? small : large).push_back(i);
+		}
+		while (!small.empty() && !large.empty()) {
+			unsigned s = small.back(), l = large.back();
+			small.pop_back();
+			alias[s] = l;
+			prob[l] -= 1 - prob[s];
+			if (prob[l] < 1) {
+				large.pop_back();
+				small.push_back(l);
+			}
+		}
+		for (unsigned i : small) {
+			prob[i] = 1;  // Only rounding left these short
+		}
+		for (unsigned i : large) {
+			prob[i] = 1;
+		}
+	}
+
+	unsigned operator()(RandomStream& draws) const {
+		unsigned i = (unsigned)(draws() % prob.size());
+		return draws.uniform() < prob[i] ? i : alias[i];
+	}
+};
+
+// Power-law weights of mean avgDegree: w_i proportional to (i + 1)^-alpha
+static std::vector<double> powerLawWeights(unsigned n, double avgDegree,
+										   double exponent) {
+	double alpha = 1 / (exponent - 1);
+	std::vector<double> w(n);
+	double total = 0;
+	for (unsigned i = 0; i < n; ++i) {
+		w[i] = std::pow(i + 1.0, -alpha);
+		total += w[i];
+	}
+	for (double& wi : w) {
+		wi *= avgDegree * n / total;
+	}
+	return w;
+}
+
+Matrix powerLawMatrix(unsigned r, unsigned c, double avgDegree,
+					  double exponent, uint64_t seed, unsigned threads,
+					  double noise) {
+	if (exponent <= 2 || avgDegree <= 0) {
+		std::cout << "powerLawMatrix ERROR: need exponent > 2, degree > 0\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	// Hubs land on scattered indices, not on the first rows and columns;
+	// the orders have their own tag, apart from every column's draws
+	Permutation rowOrder(r, hashKey(seed, TAG_ORDER, 0));
+	Permutation colOrder(c, hashKey(seed, TAG_ORDER, 1));
+	std::vector<double> rowWeights = powerLawWeights(r, avgDegree, exponent);
+	std::vector<double> colWeights = powerLawWeights(c, avgDegree, exponent);
+	AliasTable pick(rowWeights);
+
+	return buildColumns(
+		r, c, seed, threads, noise,
+		[&](unsigned col, RandomStream& draws, std::vector<int>& rows) {
+			double w = std::min((double)r, colWeights[colOrder.inverse(col)]);
+			unsigned degree = (unsigned)w + (draws.uniform() < w - (unsigned)w);
+			// Rows col, col + c, ... of the row order are anchored here, in
+			// place of as many draws, so that no row is left empty
+			unsigned anchors = 0;
+			for (unsigned i = col; i < r; i += c, ++anchors) {
+				rows.push_back((int)rowOrder(i));
+			}
+			for (unsigned i = anchors; i < std::max(1u, degree); ++i) {
+				rows.push_back((int)rowOrder(pick(draws)));
+			}
+		});
+}
+
+Matrix blockMatrix(unsigned r, unsigned c, unsigned blocks, double p,
+				   double crossP, uint64_t seed, unsigned threads,
+				   double noise) {
+	if (blocks == 0 || blocks > std::min(r, c)) {
+		std::cout << "blockMatrix ERROR: need 1 <= blocks <= min(r, c)\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	return buildColumns(
+		r, c, seed, threads, noise,
+		[&](unsigned col, RandomStream& draws, std::vector<int>& rows) {
+			uint64_t block = (uint64_t)col * blocks / c;
+			unsigned lo = (unsigned)(block * r / blocks);
+			unsigned hi = (unsigned)((block + 1) * r / blocks);
+			rows.push_back((int)(lo + draws() % (hi - lo)));
+			bernoulliRows(lo, hi, p, draws, rows);
+			bernoulliRows(0, lo, crossP, draws, rows);
+			bernoulliRows(hi, r, crossP, draws, rows);
+		});
+}
+
+Matrix bandedMatrix(unsigned r, unsigned c, unsigned bandwidth, uint64_t seed,
+					unsigned threads, double noise) {
+	return buildColumns(
+		r, c, seed, threads, noise,
+		[&](unsigned col, RandomStream&, std::vector<int>& rows) {
+			unsigned diagonal = (unsigned)((uint64_t)col * r / c);
+			unsigned lo = diagonal > bandwidth ? diagonal - bandwidth : 0;
+			unsigned hi = std::min(r - 1, diagonal + bandwidth);
+			for (unsigned row = lo; row <= hi; ++row) {
+				rows.push_back((int)row);
+			}
+		});
+}
+
+Matrix preferentialMatrix(unsigned r, unsigned c, unsigned degree,
+						  uint64_t seed, double noise) {
+	if (degree == 0 || degree > r) {
+		std::cout << "preferentialMatrix ERROR: need 1 <= degree <= r\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	// Each row appears once, plus once per edge: a uniform pick from the
+	// list is a pick proportional to one plus degree
+	std::vector<unsigned> targets(r);
+	for (unsigned row = 0; row < r; ++row) {
+		targets[row] = row;
+	}
+	targets.reserve(r + (size_t)c * degree);
+	std::vector<std::vector<int>> cols(c);
+	for (unsigned col = 0; col < c; ++col) {
+		RandomStream draws = columnStream(seed, col);
+		std::vector<int>& rows = cols[col];
+		size_t available = targets.size();  // Edges of this column wait
+		while (rows.size() < degree) {
+			int row = (int)targets[draws() % available];
+			if (std::find(rows.begin(), rows.end(), row) == rows.end()) {
+				rows.push_back(row);
+			}
+		}
+		for (int row : rows) {
+			targets.push_back((unsigned)row);
+		}
+	}
+	return buildColumns(
+		r, c, seed, 1, noise,
+		[&](unsigned col, RandomStream&, std::vector<int>& rows) {
+			rows.swap(cols[col]);
+		});
+}
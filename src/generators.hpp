@@ -0,0 +1,42 @@
+#ifndef GENERATORS_HPP
+#define GENERATORS_HPP
+
+// Includes
+#include "matrix.hpp"
+
+/**
+ * Seeded instance families beyond Matrix(r, c, p, noise)
+ * Values are uniform in [0, 1) and columns are normalized to unit norm,
+ * with b = A u + noise v for u, v uniform in [-1, 1), as in the uniform
+ * generator; every column has at least one nonzero. Columns are drawn
+ * from their own counter-based streams, so the parallel generators build
+ * disjoint column ranges on threads (0: every core) in O(nnz) time and
+ * give the same instance for a seed whatever the thread count.
+ */
+
+// Chung-Lu: row and column weights follow a power law with the given
+// exponent (> 2) scaled to avgDegree; column c draws about w_c rows, each
+// with probability proportional to its weight (repeats collapse). Every
+// row is also anchored in one column, in place of one of its draws, so no
+// row is empty
+Matrix powerLawMatrix(unsigned r, unsigned c, double avgDegree,
+					  double exponent, uint64_t seed, unsigned threads = 0,
+					  double noise = DEFAULT_NOISE);
+
+// blocks diagonal blocks of density p, plus cells outside the column's
+// block with probability crossP
+Matrix blockMatrix(unsigned r, unsigned c, unsigned blocks, double p,
+				   double crossP, uint64_t seed, unsigned threads = 0,
+				   double noise = DEFAULT_NOISE);
+
+// Every cell within bandwidth rows of the (scaled) diagonal
+Matrix bandedMatrix(unsigned r, unsigned c, unsigned bandwidth, uint64_t seed,
+					unsigned threads = 0, double noise = DEFAULT_NOISE);
+
+// Bipartite preferential attachment: columns arrive in order and attach
+// to degree distinct rows, each chosen with probability proportional to
+// one plus its degree so far. Sequential by nature; O(nnz) time.
+Matrix preferentialMatrix(unsigned r, unsigned c, unsigned degree,
+						  uint64_t seed, double noise = DEFAULT_NOISE);
+
+#endif  // GENERATORS_HPP
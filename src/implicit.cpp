@@ -0,0 +1,187 @@
+#include "implicit.hpp"
+
+// Tags separating the random streams derived from one seed
+const uint64_t TAG_ROW_ORDER = 1;
+const uint64_t TAG_COL_ORDER = 2;
+const uint64_t TAG_BASE = 3;
+const uint64_t TAG_NOISE = 4;
+const uint64_t TAG_NOISE_ORDER = 5;
+const uint64_t TAG_NOISE_KEEP = 6;
+const uint64_t TAG_B = 7;
+
+ImplicitMatrix::ImplicitMatrix(unsigned r, unsigned c, double p,
+							   double noise_, uint64_t seed_)
+	: rows(r),
+	  cols(c),
+	  noise(noise_),
+	  seed(seed_),
+	  rowOrder(r, hashKey(seed_, TAG_ROW_ORDER)),
+	  colOrder(c, hashKey(seed_, TAG_COL_ORDER)),
+	  lastKept(1) {
+	if (rows == 0 || cols == 0) {
+		std::cout << "ImplicitMatrix ERROR: empty matrix\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	// A diagonal puts one cell in every line of the longer side, so
+	// density p takes p * min(r, c) of them; the last one is thinned
+	double diagonals = std::max(p, 0.0) * std::min(rows, cols);
+	unsigned whole = (unsigned)std::floor(diagonals);
+	if (diagonals > whole) {
+		lastKept = diagonals - whole;
+		++whole;
+	}
+	for (unsigned d = 0; d < whole; ++d) {
+		noiseOrders.push_back(Permutation(std::max(rows, cols),
+										  hashKey(seed, TAG_NOISE_ORDER, d)));
+	}
+}
+
+uivector ImplicitMatrix::baseCols(unsigned r) const {
+	// Position i of the row order meets position i (mod) of the column order
+	uivector base;
+	uint64_t i = rowOrder.inverse(r);
+	if (rows >= cols) {
+		base.push_back((unsigned)colOrder(i % cols));
+	} else {
+		for (uint64_t j = i; j < cols; j += rows) {
+			base.push_back((unsigned)colOrder(j));
+		}
+	}
+	std::sort(base.begin(), base.end());
+	return base;
+}
+
+uivector ImplicitMatrix::baseRows(unsigned c) const {
+	uivector base;
+	uint64_t i = colOrder.inverse(c);
+	if (rows >= cols) {
+		for (uint64_t j = i; j < rows; j += cols) {
+			base.push_back((unsigned)rowOrder(j));
+		}
+	} else {
+		base.push_back((unsigned)rowOrder(i % rows));
+	}
+	std::sort(base.begin(), base.end());
+	return base;
+}
+
+uivector ImplicitMatrix::noiseCells(unsigned line, bool isRow) const {
+	// Index i of the longer side meets index order(i) mod shorter on each
+	// diagonal, so a line of the shorter side inverts every such index
+	uint64_t shorter = std::min(rows, cols);
+	uint64_t longer = std::max(rows, cols);
+	bool isLong = isRow == (rows >= cols);
+	uivector cells;
+	for (unsigned d = 0; d < noiseOrders.size(); ++d) {
+		const Permutation& order = noiseOrders[d];
+		bool thinned = d + 1 == noiseOrders.size() && lastKept < 1;
+		for (uint64_t j = line; j < (isLong ? line + 1 : longer);
+			 j += shorter) {
+			unsigned cross = isLong ? (unsigned)(order(j) % shorter)
+									: (unsigned)order.inverse(j);
+			unsigned r = isRow ? line : cross;
+			unsigned c = isRow ? cross : line;
+			if (!thinned ||
+				toUniform(hashKey(seed, TAG_NOISE_KEEP, r, c)) < lastKept) {
+				cells.push_back(cross);
+			}
+		}
+	}
+	// Diagonals may cross on a cell, which is noisy once
+	std::sort(cells.begin(), cells.end());
+	cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+	return cells;
+}
+
+double ImplicitMatrix::rawValue(unsigned r, unsigned c, bool base,
+								bool noisy) const {
+	double value = 0;
+	if (base) {
+		value += toUniform(hashKey(seed, TAG_BASE, r, c));
+	}
+	if (noisy) {
+		value += toUniform(hashKey(seed, TAG_NOISE, r, c));
+	}
+	return value;
+}
+
+SpVec ImplicitMatrix::rawCol(unsigned c) const {
+	uivector base = baseRows(c);
+	uivector noisy = noiseCells(c, false);
+
+	// Merge sorted diagonal and noise rows
+	SpVec col(rows);
+	col.reserve(base.size() + noisy.size());
+	auto b = base.begin();
+	auto n = noisy.begin();
+	while (b != base.end() || n != noisy.end()) {
+		unsigned r;
+		bool isBase = false, isNoisy = false;
+		if (n == noisy.end() || (b != base.end() && *b <= *n)) {
+			r = *b;
+			isBase = true;
+			++b;
+		} else {
+			r = *n;
+		}
+		if (n != noisy.end() && *n == r) {
+			isNoisy = true;
+			++n;
+		}
+		col.insertBack(r) = rawValue(r, c, isBase, isNoisy);
+	}
+	return col;
+}
+
+SpVec ImplicitMatrix::getCol(unsigned c) const {
+	if (c >= cols) {
+		std::cout << "getCol ERROR: col exceeds number of columns\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	SpVec col = rawCol(c);
+	return col / col.norm();
+}
+
+SpVec ImplicitMatrix::getRow(unsigned r) const {
+	if (r >= rows) {
+		std::cout << "getRow ERROR: row exceeds number of rows\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	uivector base = baseCols(r);
+	uivector noisy = noiseCells(r, true);
+
+	SpVec row(cols);
+	row.reserve(base.size() + noisy.size());
+	auto b = base.begin();
+	auto n = noisy.begin();
+	while (b != base.end() || n != noisy.end()) {
+		unsigned c;
+		bool isBase = false, isNoisy = false;
+		if (n == noisy.end() || (b != base.end() && *b <= *n)) {
+			c = *b;
+			isBase = true;
+			++b;
+		} else {
+			c = *n;
+		}
+		if (n != noisy.end() && *n == c) {
+			isNoisy = true;
+			++n;
+		}
+		row.insertBack(c) = rawValue(r, c, isBase, isNoisy) / rawCol(c).norm();
+	}
+	return row;
+}
+
+double ImplicitMatrix::getB(unsigned r) const {
+	// b_r = sum_c a_rc u_c + noise * v_r, with u, v uniform in [-1, 1)
+	SpVec row = getRow(r);
+	double b = noise * (2 * toUniform(hashKey(seed, TAG_B, 0, r)) - 1);
+	for (SpVec::InnerIterator it(row); it; ++it) {
+		double u = 2 * toUniform(hashKey(seed, TAG_B, 1, it.index())) - 1;
+		b += it.value() * u;
+	}
+	return b;
+}
@@ -0,0 +1,100 @@
+#ifndef IMPLICIT_HPP
+#define IMPLICIT_HPP
+
+// Includes
+#include <cmath>
+#include <functional>
+#include "oracle.hpp"
+#include "random.hpp"
+
+/**
+ * Random constraint matrix generated on demand, never stored in full
+ * Same construction as Matrix(r, c, p, noise): a cyclic diagonal under
+ * random row and column orders plus noise of density p, with unit-norm
+ * columns and b = A u + noise v for u, v uniform in [-1, 1]
+ *
+ * Every entry is a pure function of (seed, row, col), so any probe order,
+ * any thread and any copy see the same instance, and nothing is kept
+ * between probes. For that the noise is not drawn cell by cell: it lies on
+ * p * min(r, c) further random diagonals, each pairing every index of the
+ * longer side with one of the shorter through a keyed permutation, the
+ * last one thinned by a per-cell draw for the fractional part. A line is
+ * then enumerated in O(p * max(r, c) / min(r, c)) permutation evaluations,
+ * and the noise of distinct cells is no longer independent.
+ */
+class ImplicitMatrix final : public Oracle {
+private:
+	unsigned rows;
+	unsigned cols;
+	double noise;
+	uint64_t seed;
+	Permutation rowOrder;
+	Permutation colOrder;
+	std::vector<Permutation> noiseOrders;  // One per noise diagonal
+	double lastKept;  // Share of the last diagonal's cells that are noise
+
+	// Sorted cells of row r / column c on the base diagonal
+	uivector baseCols(unsigned r) const;
+	uivector baseRows(unsigned c) const;
+	// Sorted cells of a row or column on the noise diagonals
+	uivector noiseCells(unsigned line, bool isRow) const;
+
+	// Unnormalized column c and a value from its diagonal memberships
+	SpVec rawCol(unsigned c) const;
+	double rawValue(unsigned r, unsigned c, bool base, bool noisy) const;
+
+public:
+	ImplicitMatrix(unsigned r, unsigned c, double p, double noise_,
+				   uint64_t seed_);
+	ImplicitMatrix(unsigned r, unsigned c, uint64_t seed_)
+		: ImplicitMatrix(r, c, SPARSITY_BASE / c, DEFAULT_NOISE, seed_) {}
+
+	// Oracle interface
+	unsigned getRows() const override {
+		return rows;
+	}
+	unsigned getCols() const override {
+		return cols;
+	}
+	SpVec getRow(unsigned r) const override;
+	SpVec getCol(unsigned c) const override;
+	double getB(unsigned r) const override;
+};
+
+// Ranks in [0, 1) derived from a seed, indexable like a dvector
+class ImplicitRanks {
+private:
+	uint64_t seed;
+	unsigned num;
+
+public:
+	ImplicitRanks(unsigned n, uint64_t seed_) : seed(seed_), num(n) {}
+
+	double operator[](unsigned i) const {
+		return toUniform(hashKey(seed, TAG_RANK, i));
+	}
+	unsigned size() const {
+		return num;
+	}
+};
+
+// Cost functions produced per index on demand, indexable like an fvector
+class ImplicitFunctions {
+private:
+	std::function<std::function<double(double)>(unsigned)> make;
+	unsigned num;
+
+public:
+	ImplicitFunctions(
+		unsigned n, std::function<std::function<double(double)>(unsigned)> f)
+		: make(f), num(n) {}
+
+	std::function<double(double)> operator[](unsigned j) const {
+		return make(j);
+	}
+	unsigned size() const {
+		return num;
+	}
+};
+
+#endif  // IMPLICIT_HPP
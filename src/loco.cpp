@@ -1,7 +1,37 @@
 #include "loco.hpp"
 
+const uint64_t TAG_SKETCH = 0x534b4554;  // "SKET", keys of cost sketches
+const unsigned SKETCH_SIZE = 64;         // Duals kept per cost sketch
+
+KernelThresholds thresholds = DEFAULT_THRESHOLDS;
+
+// Run body(i) for every i in [0, count) on threads (0: every core), the
+// calling thread included; indices are handed out in order as threads
+// become free
+template <typename Body>
+static void runPool(unsigned count, unsigned threads, Body body) {
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	std::atomic<unsigned> next(0);
+	auto worker = [&]() {
+		for (unsigned i = next++; i < count; i = next++) {
+			body(i);
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < std::min(threads, count); ++t) {
+		pool.push_back(std::thread(worker));
+	}
+	worker();
+	for (std::thread& t : pool) {
+		t.join();
+	}
+}
+
 MatrixSolution solve(online alg, const Matrix& matrix, const fvector& funs,
-					 dvector ranks) {
+					 dvector ranks, unsigned threads, unsigned budget) {
 	unsigned numPrimal = matrix.getCols();
 	unsigned numDual = matrix.getRows();
 	if (numDual != ranks.size()) {
@@ -11,121 +41,306 @@ MatrixSolution solve(online alg, const Matrix& matrix, const fvector& funs,
 	MatrixSolution s;
 	s.primals = dvector(numPrimal, 0);
 	s.messages = 0;
+	s.predicted = estimateCosts(matrix, ranks, budget);
+	s.actual = uivector(numPrimal, 0);
+	s.truncated = 0;
+
+	// Hand out queries most expensive first, so long explorations start
+	// early and cheap ones fill in the gaps at the end (LPT scheduling)
+	uivector order = scheduleQueries(s.predicted);
+	std::atomic<unsigned> truncated(0);
+	std::atomic<unsigned> probes(0);
+	runPool(numPrimal, threads, [&](unsigned i) {
+		unsigned ind = order[i];
+		LocoSolution x = loco(alg, matrix, funs, ranks, ind, budget);
+		s.primals[ind] = x.primal;
+		s.actual[ind] = x.messages;
+		probes += x.probes;
+		if (x.truncated) {
+			++truncated;
+		}
+	});
 
-	for (unsigned i = 0; i < numPrimal; ++i) {
-		LocoSolution x = loco(alg, matrix, funs, ranks, i);
-		s.primals[i] = x.primal;
-		s.messages += x.messages;
+	for (unsigned messages : s.actual) {
+		s.messages += messages;
 	}
+	s.truncated = truncated;
+	s.probes = probes;
 
 	return s;
 }
 
-LocoSolution loco(online alg, const Matrix& matrix, const fvector& funs,
-				  const dvector& ranks, unsigned ind) {
-	LocoSolution local;
-	local.messages = 0;
-
-	// Step 1: Find sets X_k and Y_k associated with x_k (k = ind)
-	uivector x;
-	uivector y = { maxRank(matrix.getCol(ind), ranks) };
+ScenarioSolution solveScenarios(online alg, const Matrix& matrix,
+								const std::vector<Scenario>& scenarios,
+								dvector ranks, unsigned threads,
+								unsigned budget) {
+	unsigned numPrimal = matrix.getCols();
+	unsigned numDual = matrix.getRows();
+	for (const Scenario& scenario : scenarios) {
+		if (scenario.funs.size() < numPrimal) {
+			std::cout << "solveScenarios ERROR: fewer functions than columns\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		if (scenario.b.size() != 0 && scenario.b.size() != numDual) {
+			std::cout << "solveScenarios ERROR: b, rows size mismatch!\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	if (numDual != ranks.size()) {
+		ranks = generateRanks(numDual);
+	}
 
-	unsigned curr = 0, end = 1;
-	while (curr < end) {
-		unsigned k = y[curr++];  // Current dual variable index
-		SpVec row = matrix.getRow(k);
+	// Scenarios of one primal are adjacent, so each query writes one column
+	ScenarioSolution s;
+	s.primals = DMat::Zero(scenarios.size(), numPrimal);
+	s.messages = 0;
+	s.actual = uivector(numPrimal, 0);
+	s.truncated = 0;
+
+	uivector order = scheduleQueries(estimateCosts(matrix, ranks, budget));
+	std::atomic<unsigned> truncated(0);
+	std::atomic<unsigned> probes(0);
+	runPool(numPrimal, threads, [&](unsigned i) {
+		unsigned ind = order[i];
+		LocoSolution x = locoScenarios(alg, matrix, scenarios, ranks, ind,
+									   s.primals.col(ind), budget);
+		s.actual[ind] = x.messages;
+		probes += x.probes;
+		if (x.truncated) {
+			++truncated;
+		}
+	});
 
-		// Iterate over nonzero elements in vector of primal variables
-		// corresponding to current dual variable index
-		for (SpVec::InnerIterator itP(row); itP; ++itP) {
-			unsigned y0 = itP.index();
-			SpVec col = matrix.getCol(y0);
+	for (unsigned messages : s.actual) {
+		s.messages += messages;
+	}
+	s.truncated = truncated;
+	s.probes = probes;
 
-			// Iterate over nonzero elements in vector of dual variables
-			// corresponding to outer iteration's primal variable index
-			for (SpVec::InnerIterator itD(col); itD; ++itD) {
-				++local.messages;  // +1 communication!
+	return s;
+}
 
-				unsigned x0 = itD.index();
-				if (std::find(x.begin(), x.end(), x0) == x.end()) {
-					x.push_back(x0);  // If primal index not in x yet, add it
-				}
+RepeatedSolution solveRepeated(online alg, const Matrix& matrix,
+							   const fvector& funs, unsigned repetitions,
+							   uint64_t seed, Combine combine,
+							   unsigned threads, unsigned budget) {
+	unsigned numPrimal = matrix.getCols();
+	unsigned numDual = matrix.getRows();
+	if (repetitions == 0) {
+		std::cout << "solveRepeated ERROR: no repetitions\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (funs.size() < numPrimal) {
+		std::cout << "solveRepeated ERROR: fewer functions than columns\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
 
-				if (ranks[y0] < ranks[k] &&
-					std::find(y.begin(), y.end(), y0) == y.end()) {
-					y.push_back(y0);  // If dual index not in y yet, add it
-					++end;
-				}
-			}
+	// One queue over every (repetition, primal), most expensive first, so
+	// repetitions run concurrently instead of one pool after another
+	std::vector<dvector> ranks(repetitions);
+	uivector costs;
+	costs.reserve(repetitions * numPrimal);
+	for (unsigned r = 0; r < repetitions; ++r) {
+		ranks[r] = generateRanks(numDual, repetitionSeed(seed, r));
+		uivector c = estimateCosts(matrix, ranks[r], budget);
+		costs.insert(costs.end(), c.begin(), c.end());
+	}
+	uivector order = scheduleQueries(costs);
+
+	RepeatedSolution s;
+	s.repetitions = DMat::Zero(repetitions, numPrimal);
+	uivector actual(repetitions * numPrimal, 0);
+	std::atomic<unsigned> truncated(0);
+	std::atomic<unsigned> probes(0);
+	runPool((unsigned)order.size(), threads, [&](unsigned i) {
+		unsigned r = order[i] / numPrimal;
+		unsigned ind = order[i] % numPrimal;
+		LocoSolution x = loco(alg, matrix, funs, ranks[r], ind, budget);
+		s.repetitions(r, ind) = x.primal;
+		actual[order[i]] = x.messages;
+		probes += x.probes;
+		if (x.truncated) {
+			++truncated;
+		}
+	});
+
+	s.messages = uivector(repetitions, 0);
+	s.objectives = dvector(repetitions, 0);
+	s.best = 0;
+	for (unsigned r = 0; r < repetitions; ++r) {
+		for (unsigned j = 0; j < numPrimal; ++j) {
+			s.messages[r] += actual[r * numPrimal + j];
+			s.objectives[r] += funs[j](s.repetitions(r, j));
+		}
+		if (s.objectives[r] < s.objectives[s.best]) {
+			s.best = r;
+		}
+	}
+	s.truncated = truncated;
+	s.probes = probes;
+
+	s.primals = dvector(numPrimal);
+	dvector values(repetitions);
+	for (unsigned j = 0; j < numPrimal; ++j) {
+		for (unsigned r = 0; r < repetitions; ++r) {
+			values[r] = s.repetitions(r, j);
+		}
+		switch (combine) {
+		case COMBINE_MIN:
+			s.primals[j] = *std::min_element(values.begin(), values.end());
+			break;
+		case COMBINE_MEDIAN:
+			std::nth_element(values.begin(),
+							 values.begin() + (repetitions - 1) / 2,
+							 values.end());
+			s.primals[j] = values[(repetitions - 1) / 2];
+			break;
+		case COMBINE_BEST:
+			s.primals[j] = s.repetitions(s.best, j);
+			break;
 		}
 	}
 
-	// Step 2: Use online algorithm to solve local problem defined on X_k, Y_k
-	Matrix problem = matrix.getSubmatrix(x, y);
-	local.primal = (alg(problem, restrictFunctions(funs, y), 1))(0);
-
-	return local;
+	return s;
 }
 
-dvector generateRanks(unsigned num) {
-	// Create uniform random real number generator for range [0, 1)
-	unsigned seed =
-		(unsigned)std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine gen(seed);
-	std::uniform_real_distribution<double> dist(0, 1);
+uivector estimateCosts(const Matrix& matrix, const dvector& ranks,
+					   unsigned budget) {
+	unsigned numPrimal = matrix.getCols();
+	unsigned numDual = matrix.getRows();
 
-	// Randomly generate rank in range [0, 1) for each index
-	dvector ranks(num);
-	for (unsigned i = 0; i < num; ++i) {
-		ranks[i] = dist(gen);
+	// A query expands every dual reachable from its root through duals of
+	// decreasing rank, and expanding dual k sends hop(k) messages, the
+	// column degrees of every primal on row k. One pass over the columns,
+	// each probed once into the same buffer, gives hop and the pattern
+	uivector hop(numDual, 0), root(numPrimal);
+	std::vector<uivector> rowsOf(numPrimal), colsOf(numDual);
+	SpVec col;
+	for (unsigned c = 0; c < numPrimal; ++c) {
+		matrix.probeCol(c, col);
+		root[c] = maxRank(col, ranks);
+		unsigned degree = matrix.getColDegree(c);
+		for (SpVec::InnerIterator it(col); it; ++it) {
+			unsigned k = it.index();
+			hop[k] += degree;
+			rowsOf[c].push_back(k);
+			colsOf[k].push_back(c);
+		}
 	}
-	return ranks;
-}
 
-unsigned maxRank(const SpVec& x, const dvector& ranks) {
-	unsigned k = 0;
-	double maxRank = -1;
+	// Bottom-k sketch of the duals each dual reaches: dual k draws an
+	// exponential key of rate hop(k), and in increasing rank order keeps
+	// the SKETCH_SIZE smallest keys of itself and its lower ranked
+	// neighbours' sketches. A sketch that is not full holds the whole set;
+	// otherwise the sum of hop is estimated from the smallest keys, each
+	// weighted by the inverse of its chance to fall below the last one
+	dvector key(numDual);
+	uivector byRank(numDual);
+	for (unsigned k = 0; k < numDual; ++k) {
+		double u = 1 - toUniform(hashKey(0, TAG_SKETCH, k));
+		key[k] = -std::log(u) / std::max(1u, hop[k]);
+		byRank[k] = k;
+	}
+	std::sort(byRank.begin(), byRank.end(), [&ranks](unsigned a, unsigned b) {
+		return ranks[a] < ranks[b];
+	});
+	auto byKey = [&key](unsigned a, unsigned b) {
+		return key[a] < key[b] || (key[a] == key[b] && a < b);
+	};
+	uivector sketches((size_t)numDual * SKETCH_SIZE), sizes(numDual, 0);
+	uivector merged, seen(numDual, numDual);
+	dvector estimate(numDual);
+	for (unsigned k : byRank) {
+		merged.assign(1, k);
+		seen[k] = k;
+		for (unsigned c : colsOf[k]) {
+			for (unsigned k0 : rowsOf[c]) {
+				if (ranks[k0] < ranks[k] && seen[k0] != k) {
+					seen[k0] = k;
+					auto first = sketches.begin() + (size_t)k0 * SKETCH_SIZE;
+					merged.insert(merged.end(), first, first + sizes[k0]);
+				}
+			}
+		}
+		std::sort(merged.begin(), merged.end(), byKey);
+		merged.erase(std::unique(merged.begin(), merged.end()), merged.end());
+		sizes[k] = (unsigned)std::min<size_t>(merged.size(), SKETCH_SIZE);
+		std::copy(merged.begin(), merged.begin() + sizes[k],
+				  sketches.begin() + (size_t)k * SKETCH_SIZE);
+
+		double sum = 0;
+		if (sizes[k] < SKETCH_SIZE) {
+			for (unsigned k0 : merged) {
+				sum += hop[k0];
+			}
+		} else {
+			double threshold = key[merged[SKETCH_SIZE - 1]];
+			for (unsigned i = 0; i + 1 < SKETCH_SIZE; ++i) {
+				double w = std::max(1u, hop[merged[i]]);
+				sum += w / (1 - std::exp(-w * threshold));
+			}
+		}
+		estimate[k] = sum;
+	}
 
-	// Iterate over nonzero elements in vector of dual variables
-	// Choose index corresponding to variable with highest rank
-	for (SpVec::InnerIterator it(x); it; ++it) {
-		unsigned ind = it.index();
-		double rank = ranks[ind];
-		if (rank > maxRank) {
-			maxRank = rank;
-			k = ind;
+	uivector costs(numPrimal);
+	for (unsigned c = 0; c < numPrimal; ++c) {
+		double cost = estimate[root[c]];
+		if (budget != UNLIMITED) {
+			cost = std::min(cost, (double)budget);
 		}
+		costs[c] = (unsigned)std::min(
+			cost, (double)std::numeric_limits<unsigned>::max());
 	}
+	return costs;
+}
 
-	return k;
+size_t queryStateBytes() {
+	const ProbeBuffers& buffers = probeBuffers();
+	return queryArena().getCapacity() + vectorBytes(buffers.row) +
+		vectorBytes(buffers.col) + vectorBytes(buffers.duals);
 }
 
-fvector restrictFunctions(const fvector& unrestricted, uivector y) {
-	unsigned small = (unsigned)y.size();
-	unsigned large = (unsigned)unrestricted.size();
+size_t solutionBytes(const MatrixSolution& s) {
+	return s.primals.capacity() * sizeof(double) +
+		(s.predicted.capacity() + s.actual.capacity()) * sizeof(unsigned);
+}
 
-	for (unsigned yi : y) {
-		if (yi >= large) {
-			std::cout << "restrictFunctions ERROR: yi exceeds funs vector\n"
-				<< std::endl;
-			exit(EXIT_FAILURE);
-		}
+uivector scheduleQueries(const uivector& costs) {
+	uivector order(costs.size());
+	for (unsigned i = 0; i < order.size(); ++i) {
+		order[i] = i;
 	}
+	std::stable_sort(order.begin(), order.end(),
+					 [&costs](unsigned a, unsigned b) {
+						 return costs[a] > costs[b];
+					 });
+	return order;
+}
 
-	fvector restricted(small);
-	for (unsigned i = 0; i < small; ++i) {
-		restricted[i] = unrestricted[y[i]];
-	}
+dvector generateRanks(unsigned num) {
+	return generateRanks(num, clockSeed());
+}
 
-	return restricted;
+dvector generateRanks(unsigned num, uint64_t seed) {
+	// Rank in range [0, 1) for each index, the same as ImplicitRanks
+	dvector ranks(num);
+	for (unsigned i = 0; i < num; ++i) {
+		ranks[i] = toUniform(hashKey(seed, TAG_RANK, i));
+	}
+	return ranks;
 }
 
 inline double derive(const fun& f, double x, double h) {
 	return (f(x + h) - f(x)) / h;
 }
 
-inline double dot(DVec& a, DVec& b) {
-	size_t size = a.size();
+inline double dot(const Eigen::Ref<const DVec>& a,
+				  const Eigen::Ref<const DVec>& b) {
+	Eigen::Index size = a.size();
 	if (size != b.size()) {
 		std::cout << "dot ERROR: vectors a and b different sizes\n"
 			<< std::endl;
@@ -133,66 +348,257 @@ inline double dot(DVec& a, DVec& b) {
 	}
 
 	double product = 0;
-	for (size_t i = 0; i < size; ++i) {
-		product += a(i) + b(i);
+	for (Eigen::Index i = 0; i < size; ++i) {
+		product += a(i) * b(i);
 	}
 
 	return product;
 }
 
-DVec onlineFractional(const Matrix& matrix, const fvector& funs,
-					  double delta) {
+// Working storage of onlineFractional for problems of at most MAX rows and
+// columns, held inside the object so small problems run on the stack
+template <int MAX>
+struct SmallWorkspace {
+	typedef Eigen::Matrix<double, Eigen::Dynamic, 1, 0, MAX, 1> Vec;
+
+	Vec tRow;
+	unsigned rowStart[MAX + 1], fill[MAX];
+	unsigned rowCols[MAX * MAX];
+	double rowVals[MAX * MAX];
+	double cells[MAX * MAX];
+
+	SmallWorkspace(unsigned, unsigned n) : tRow(n) {}
+	void reserveSparse(uint64_t) {}
+	void reserveDense(uint64_t) {}
+};
+
+// Working storage of onlineFractional for any size, drawn from an arena
+struct ArenaWorkspace {
+	typedef Eigen::Map<DVec> Vec;
+
+	Arena& arena;
+	Vec tRow;
+	unsigned *rowStart, *fill;
+	unsigned* rowCols;
+	double* rowVals;
+	double* cells;
+
+	ArenaWorkspace(Arena& a, unsigned m, unsigned n)
+		: arena(a),
+		  tRow(a.allocate<double>(n), n),
+		  rowStart(a.allocate<unsigned>(m + 1)),
+		  fill(a.allocate<unsigned>(m)),
+		  rowCols(nullptr),
+		  rowVals(nullptr),
+		  cells(nullptr) {}
+	void reserveSparse(uint64_t nonZeros) {
+		rowCols = arena.allocate<unsigned>(nonZeros);
+		rowVals = arena.allocate<double>(nonZeros);
+	}
+	void reserveDense(uint64_t size) {
+		cells = arena.allocate<double>(size);
+	}
+};
+
+// Online fractional algorithm on the local problem gathered either into a
+// dense column-major block or into sparse rows. Only x is returned and the
+// dual variables never feed back into it, so they are not kept: each primal
+// step costs the nonzeros of the arriving row rather than of the problem
+template <bool DENSE, typename W>
+void fractionalKernel(const MatrixView& matrix, const fvector& funs,
+					  double delta, Eigen::Ref<DVec>& x, W& w) {
+	(void)delta;  // Scales only the dual certificate
 	unsigned m = matrix.getRows();
 	unsigned n = matrix.getCols();
-
-	DVec x = DVec::Zero(n);
-	DVec y = DVec::Zero(m);
-	DVec mu = DVec::Zero(n);
-
+	typename W::Vec& tRow = w.tRow;
+	x.setZero();
+
+	// Gather the local problem once: densely, or by rows
+	unsigned* rowStart = w.rowStart;
+	std::fill(rowStart, rowStart + m + 1, 0);
+	unsigned nonZeros = 0;
+	for (unsigned j = 0; j < n; ++j) {
+		for (MatrixView::ColIterator it(matrix, j); it; ++it) {
+			++rowStart[it.row() + 1];
+			++nonZeros;
+		}
+	}
 	unsigned d = 0;  // Maximum number of nonzeros in any row of matrix
 	for (unsigned i = 0; i < m; ++i) {
-		d = std::max(d, (unsigned)matrix.getRow(i).nonZeros());
+		d = std::max(d, rowStart[i + 1]);
+		rowStart[i + 1] += rowStart[i];
+	}
+	if (DENSE) {
+		w.reserveDense((uint64_t)m * n);
+	} else {
+		w.reserveSparse(nonZeros);
+	}
+	Eigen::Map<DMat> cells(w.cells, DENSE ? m : 0, DENSE ? n : 0);
+	cells.setZero();
+	std::copy(rowStart, rowStart + m, w.fill);
+	for (unsigned j = 0; j < n; ++j) {
+		for (MatrixView::ColIterator it(matrix, j); it; ++it) {
+			if (DENSE) {
+				cells(it.row(), j) = it.value();
+				continue;
+			}
+			w.rowCols[w.fill[it.row()]] = j;
+			w.rowVals[w.fill[it.row()]++] = it.value();
+		}
 	}
-	double c = 1 / std::log(1 + 2 * d * d);
+	const unsigned* rowCols = w.rowCols;
+	const double* rowVals = w.rowVals;
 
 	for (unsigned t = 0; t < m; ++t) {
-		// Constraint t arrives, associated with y_t
-		DVec tRow = matrix.getRow(t);
-		while (dot(tRow, x) < 1) {
-			// 1. Update primal variables
-			for (unsigned j = 0; j < n; ++j) {
-				if (tRow(j) > 0) {
-					x(j) = x(j) +
-						(tRow(j) * x(j) + 1.0 / d) / derive(funs[j], x(j));
+		// Constraint t arrives
+		unsigned begin = rowStart[t], end = rowStart[t + 1];
+		if (DENSE) {
+			tRow = cells.row(t).transpose();
+			if (tRow.maxCoeff() <= 0) {
+				continue;  // No variable of a truncated problem covers row t
+			}
+			for (unsigned step = 0; step < MAX_STEPS && dot(tRow, x) < 1;
+				 ++step) {
+				for (unsigned j = 0; j < n; ++j) {
+					if (tRow(j) > 0) {
+						x(j) = x(j) +
+							(tRow(j) * x(j) + 1.0 / d) / derive(funs[j], x(j));
+					}
 				}
 			}
+			continue;
+		}
 
-			// 2. Update dual variables
-			for (unsigned j = 0; j < n; ++j) {
-				mu[j] = derive(funs[j], delta * x(j));
+		// Row t by its nonzeros only, in the column order dot() would sum
+		bool coverable = false;
+		for (unsigned k = begin; k < end; ++k) {
+			coverable = coverable || rowVals[k] > 0;
+		}
+		if (!coverable) {
+			continue;
+		}
+		for (unsigned step = 0; step < MAX_STEPS; ++step) {
+			double covered = 0;
+			for (unsigned k = begin; k < end; ++k) {
+				covered += rowVals[k] * x(rowCols[k]);
 			}
-			double s = derive(funs[0], delta * x(0)) / derive(funs[0], x(0));
-			for (unsigned k = 1; k < n; ++k) {
-				s = std::min(
-					s, derive(funs[k], delta * x(k)) / derive(funs[k], x(k)));
+			if (covered >= 1) {
+				break;
 			}
-			s *= c;
-			y(t) += s;
-
-			for (unsigned j = 0; j < n; ++j) {
-				DVec jCol = DVec(matrix.getCol(j));
-				if (checkError(dot(jCol, y), mu(j))) {
-					unsigned ind = 0;
-					for (unsigned i = 0; i < t; ++i) {
-						if (y(i) > 0) {
-							ind = i;
-						}
-						y(ind) -= jCol(t) / jCol(ind) * s;
-					}
+			for (unsigned k = begin; k < end; ++k) {
+				unsigned j = rowCols[k];
+				if (rowVals[k] > 0) {
+					x(j) = x(j) +
+						(rowVals[k] * x(j) + 1.0 / d) / derive(funs[j], x(j));
 				}
 			}
 		}
 	}
+}
+
+// Run the kernel on storage sized for the problem; x is forwarded by
+// reference, since copying an Eigen::Ref is deprecated
+template <bool DENSE>
+void fractionalBySize(const MatrixView& matrix, const fvector& funs,
+					  double delta, Eigen::Ref<DVec>& x) {
+	unsigned m = matrix.getRows();
+	unsigned n = matrix.getCols();
+
+	// Most local problems are tiny; give them fixed-capacity storage by size
+	// bucket so the per-call overhead stays in registers and L1
+	unsigned size = std::max(m, n);
+	if (size <= 4) {
+		SmallWorkspace<4> w(m, n);
+		fractionalKernel<DENSE>(matrix, funs, delta, x, w);
+	} else if (size <= 8) {
+		SmallWorkspace<8> w(m, n);
+		fractionalKernel<DENSE>(matrix, funs, delta, x, w);
+	} else if (size <= SMALL_PROBLEM) {
+		SmallWorkspace<SMALL_PROBLEM> w(m, n);
+		fractionalKernel<DENSE>(matrix, funs, delta, x, w);
+	} else {
+		Arena& arena = queryArena();
+		ArenaScope scope(arena);
+		ArenaWorkspace w(arena, m, n);
+		fractionalKernel<DENSE>(matrix, funs, delta, x, w);
+	}
+}
+
+void onlineFractionalDense(const MatrixView& matrix, const fvector& funs,
+						   double delta, Eigen::Ref<DVec> x) {
+	fractionalBySize<true>(matrix, funs, delta, x);
+}
+
+void onlineFractionalSparse(const MatrixView& matrix, const fvector& funs,
+							double delta, Eigen::Ref<DVec> x) {
+	fractionalBySize<false>(matrix, funs, delta, x);
+}
+
+void onlineFractional(const MatrixView& matrix, const fvector& funs,
+					  double delta, Eigen::Ref<DVec> x) {
+	if (preferDense(matrix.getRows(), matrix.getCols(),
+					matrix.getNonZeros())) {
+		fractionalBySize<true>(matrix, funs, delta, x);
+	} else {
+		fractionalBySize<false>(matrix, funs, delta, x);
+	}
+}
 
-	return x;
-}  // TODO: Test dense vs sparse performance
+KernelThresholds getKernelThresholds() {
+	return thresholds;
+}
+
+void setKernelThresholds(KernelThresholds t) {
+	thresholds = t;
+}
+
+bool preferDense(unsigned rows, unsigned cols, unsigned nonZeros) {
+	uint64_t cells = (uint64_t)rows * cols;  // 32 bits overflow past 65536^2
+	return cells > 0 && cells <= (uint64_t)thresholds.maxCells &&
+		nonZeros >= thresholds.density * cells;
+}
+
+KernelThresholds calibrateKernels(unsigned repeats) {
+	const unsigned sizes[] = { 4, 8, 16, 32, 64 };
+	const double densities[] = { 0.05, 0.1, 0.2, 0.4, 0.7, 1 };
+	fvector funs(64, [](double x) { return x * x; });
+
+	// Dense is used up to the largest size where it ever wins, from the
+	// highest density at which it started winning for any of those sizes
+	KernelThresholds t = { 1, 0 };
+	double crossover = 0;
+	for (unsigned size : sizes) {
+		uivector all(size);
+		for (unsigned i = 0; i < size; ++i) {
+			all[i] = i;
+		}
+		DVec x(size);
+		for (double density : densities) {
+			Matrix problem(size, size, density, DEFAULT_NOISE,
+						   hashKey(size, (uint64_t)(density * 100)));
+			ArenaScope scope(queryArena());
+			MatrixView view = problem.getView(all, all);
+
+			auto start = std::chrono::steady_clock::now();
+			for (unsigned r = 0; r < repeats; ++r) {
+				onlineFractionalDense(view, funs, 1, x);
+			}
+			auto dense = std::chrono::steady_clock::now() - start;
+			start = std::chrono::steady_clock::now();
+			for (unsigned r = 0; r < repeats; ++r) {
+				onlineFractionalSparse(view, funs, 1, x);
+			}
+			auto sparse = std::chrono::steady_clock::now() - start;
+
+			if (dense < sparse) {
+				t.maxCells = size * size;
+				crossover = std::max(crossover, density);
+				break;
+			}
+		}
+	}
+	if (t.maxCells > 0) {
+		t.density = crossover;
+	}
+	return t;
+}
@@ -2,35 +2,371 @@
 #define LOCO_HPP
 
 // Includes
+#include <atomic>
 #include <functional>
+#include <thread>
 #include "matrix.hpp"
+#include "oracle.hpp"
+#include "profile.hpp"
+#include "trace.hpp"
 
 // Typedefs and constants
 typedef std::vector<double> dvector;
 typedef std::function<double(double)> fun;  // Problem constraint function type
-typedef std::vector<fun> fvector;
-// Type for online algorithms
-typedef DVec(*online)(const Matrix&, const fvector&, double);
+typedef std::vector<fun, ArenaAllocator<fun>> fvector;
+// Type for online algorithms: solve the local problem, writing primals to x
+typedef void (*online)(const MatrixView&, const fvector&, double,
+					   Eigen::Ref<DVec>);
 typedef struct {
 	double primal;
 	unsigned messages;
+	bool truncated;  // Exploration stopped early by the message budget
+	unsigned probes;  // Row and column probes made to the oracle
 } LocoSolution;  // Solution from local problem for primal variable x_k
 typedef struct {
 	dvector primals;
 	unsigned messages;
+	uivector predicted;  // Estimated messages for each primal's local problem
+	uivector actual;     // Messages actually sent for each primal
+	unsigned truncated;  // Number of queries that exceeded the budget
+	unsigned probes;     // Total oracle probes over all queries
 } MatrixSolution;  // Solution for all primal variables of matrix
+typedef struct {
+	fvector funs;  // Cost functions of this scenario
+	DVec b;        // Right hand side, or empty to keep the matrix's
+} Scenario;
+typedef struct {
+	DMat primals;        // primals(s, j) is x_j under scenario s
+	unsigned messages;   // Exploration messages, shared by all scenarios
+	uivector actual;     // Messages for each primal's exploration
+	unsigned truncated;  // Number of queries that exceeded the budget
+	unsigned probes;     // Total oracle probes over all queries
+} ScenarioSolution;  // Solutions for all primals of matrix, per scenario
+
+// How solveRepeated combines the repetitions of each primal
+enum Combine {
+	COMBINE_MIN,     // Least value over repetitions
+	COMBINE_MEDIAN,  // Median value, the lower one for an even count
+	COMBINE_BEST     // Every primal from the repetition of least cost
+};
+typedef struct {
+	dvector primals;     // Combined over repetitions
+	DMat repetitions;    // repetitions(r, j) is x_j in repetition r
+	dvector objectives;  // sum_j f_j(x_j) of each repetition
+	uivector messages;   // Messages of each repetition
+	unsigned best;       // Repetition of least objective
+	unsigned truncated;  // Number of queries that exceeded the budget
+	unsigned probes;     // Total oracle probes over all queries
+} RepeatedSolution;
+const uint64_t TAG_REPETITION = 0x52455053;  // "REPS", repetition seeds
+
+// Rows and columns probed by the query running on this thread, reused
+// across its queries so the hot path need not allocate
+typedef struct {
+	SpVec row, col;  // Exploration
+	SpVec duals;     // maxRank
+} ProbeBuffers;
+inline ProbeBuffers& probeBuffers() {
+	static thread_local ProbeBuffers buffers;
+	return buffers;
+}
 const double CHANGE = 1e-3;
+// Primal steps the online algorithm spends on one arriving row; a row whose
+// best coefficient a is tiny needs on the order of 1/a^2 of them, so the cap
+// keeps one such row from stalling a query and leaves it partly covered
+const unsigned MAX_STEPS = 1 << 16;
+const unsigned UNLIMITED = 0;  // No exploration budget
+const int SMALL_PROBLEM = 16;  // Largest local problem kept on the stack
+
+// onlineFractional runs its dense kernel on local problems of at most
+// maxCells cells with at least density nonzeros per cell, else the sparse one
+typedef struct {
+	double density;
+	unsigned maxCells;
+} KernelThresholds;
+const KernelThresholds DEFAULT_THRESHOLDS = { 0.25, 1024 };
 
+// Exploration budget: once a query has sent `budget` messages, the search
+// for X_k and Y_k stops and the online algorithm runs on the neighbourhood
+// found so far (truncated exploration). Constraints outside that partial
+// neighbourhood are ignored, so the primal may differ from the unbudgeted
+// one; such queries are flagged in LocoSolution::truncated and counted in
+// MatrixSolution::truncated.
 MatrixSolution solve(online alg, const Matrix& matrix, const fvector& funs,
-					 dvector ranks = dvector());
-LocoSolution loco(online alg, const Matrix& matrix, const fvector& funs,
-				  const dvector& ranks, unsigned ind);
+					 dvector ranks = dvector(), unsigned threads = 0,
+					 unsigned budget = UNLIMITED);
+template <typename O, typename F, typename R>
+LocoSolution loco(online alg, const O& oracle, const F& funs, const R& ranks,
+				  unsigned ind, unsigned budget = UNLIMITED);
+// Messages each query sends, capped at budget, from bottom-k sketches of
+// the duals its root reaches: exact when a root reaches fewer than 64
+// duals, otherwise within about 1 / sqrt(62), 13%, relative standard error
+uivector estimateCosts(const Matrix& matrix, const dvector& ranks,
+					   unsigned budget = UNLIMITED);
+// Memory of the calling thread's query state (arena and probe buffers,
+// spare capacity included); a pool of T threads holds about T times this
+size_t queryStateBytes();
+size_t solutionBytes(const MatrixSolution& s);
+// Exploration depends only on the matrix and ranks, so every scenario
+// reuses it: one exploration, then one online run per scenario
+ScenarioSolution solveScenarios(online alg, const Matrix& matrix,
+								const std::vector<Scenario>& scenarios,
+								dvector ranks = dvector(),
+								unsigned threads = 0,
+								unsigned budget = UNLIMITED);
+// Boost with independent rank assignments: repetition r draws its ranks
+// from repetitionSeed(seed, r), and all R x n queries share one pool
+RepeatedSolution solveRepeated(online alg, const Matrix& matrix,
+							   const fvector& funs, unsigned repetitions,
+							   uint64_t seed, Combine combine = COMBINE_MEDIAN,
+							   unsigned threads = 0,
+							   unsigned budget = UNLIMITED);
+inline uint64_t repetitionSeed(uint64_t seed, unsigned r) {
+	return hashKey(seed, TAG_REPETITION, r);
+}
+template <typename O, typename R>
+LocoSolution locoScenarios(online alg, const O& oracle,
+						   const std::vector<Scenario>& scenarios,
+						   const R& ranks, unsigned ind, Eigen::Ref<DVec> out,
+						   unsigned budget = UNLIMITED);
+template <typename O, typename R>
+void explore(const ProbeCounter<O>& matrix, const R& ranks, unsigned ind,
+			 unsigned budget, uivector& x, uivector& y, LocoSolution& local,
+			 QueryProfile& profile, QueryTrace& trace);
+// One exploration step, shared by explore() and the asynchronous LocoTask:
+// walk column y0, reached from dual k, sending a message per nonzero; y0
+// joins Y_k and the duals on it ranked below k are queued into X_k
+template <typename R>
+void exploreCol(const SpVec& col, unsigned y0, unsigned k, const R& ranks,
+				unsigned budget, uivector& x, uivector& y,
+				LocoSolution& local);
+uivector scheduleQueries(const uivector& costs);
 dvector generateRanks(unsigned num);
-unsigned maxRank(const SpVec& x, const dvector& ranks);
-fvector restrictFunctions(const fvector& unrestricted, uivector y);
+dvector generateRanks(unsigned num, uint64_t seed);
+template <typename R>
+unsigned maxRank(const SpVec& x, const R& ranks);
+template <typename O, typename R>
+unsigned maxRank(const O& oracle, unsigned col, const R& ranks);
+template <typename F>
+fvector restrictFunctions(const F& unrestricted, const uivector& y,
+						  Arena* arena = nullptr);
 inline double derive(const fun& f, double x, double h = CHANGE);
-inline double dot(DVec& a, DVec& b);
-DVec onlineFractional(const Matrix& matrix, const fvector& funs, double delta);
+inline double dot(const Eigen::Ref<const DVec>& a,
+				  const Eigen::Ref<const DVec>& b);
+void onlineFractional(const MatrixView& matrix, const fvector& funs,
+					  double delta, Eigen::Ref<DVec> x);
+void onlineFractionalDense(const MatrixView& matrix, const fvector& funs,
+						   double delta, Eigen::Ref<DVec> x);
+void onlineFractionalSparse(const MatrixView& matrix, const fvector& funs,
+							double delta, Eigen::Ref<DVec> x);
+
+// Kernel selection; thresholds are process-wide, so set them before solving
+KernelThresholds getKernelThresholds();
+void setKernelThresholds(KernelThresholds t);
+bool preferDense(unsigned rows, unsigned cols, unsigned nonZeros);
+// Time both kernels on random problems of growing size and density
+KernelThresholds calibrateKernels(unsigned repeats = 20);
+
+// Templates over oracle type O (see oracle.hpp), cost functions F and ranks
+// R; F and R only need operator[] and size(), like fvector and dvector
+template <typename O, typename F, typename R>
+LocoSolution loco(online alg, const O& oracle, const F& funs, const R& ranks,
+				  unsigned ind, unsigned budget) {
+	LocoSolution local;
+	local.messages = 0;
+	local.truncated = false;
+	ProbeCounter<O> matrix(oracle);  // All probes go through the counter
+	QueryProfile profile;            // No-op unless built with LOCO_PROFILE
+	QueryTrace trace(ind);           // No-op unless tracing is started
+
+	// Temporaries come from this thread's arena, released when loco returns
+	Arena& arena = queryArena();
+	ArenaScope scope(arena);
+
+	// Step 1: Find sets X_k and Y_k associated with x_k (k = ind)
+	uivector x((ArenaAllocator<unsigned>(&arena)));
+	uivector y((ArenaAllocator<unsigned>(&arena)));
+	explore(matrix, ranks, ind, budget, x, y, local, profile, trace);
+
+	// Step 2: Use online algorithm to solve local problem defined on X_k, Y_k
+	fvector restricted = restrictFunctions(funs, y, &arena);
+	Eigen::Map<DVec> primals(arena.allocate<double>(y.size()), y.size());
+	profile.phase(PHASE_RESTRICT);
+	viewSubmatrix(matrix, x, y, [&](const MatrixView& problem) {
+		profile.phase(PHASE_SUBMATRIX);
+		alg(problem, restricted, 1, primals);
+		profile.phase(PHASE_ALG);
+	});
+	local.primal = primals(0);
+	local.probes = matrix.getProbes();
+
+	return local;
+}
+
+template <typename O, typename R>
+LocoSolution locoScenarios(online alg, const O& oracle,
+						   const std::vector<Scenario>& scenarios,
+						   const R& ranks, unsigned ind, Eigen::Ref<DVec> out,
+						   unsigned budget) {
+	LocoSolution local;
+	local.messages = 0;
+	local.truncated = false;
+	ProbeCounter<O> matrix(oracle);
+	QueryProfile profile;
+	QueryTrace trace(ind);
+
+	Arena& arena = queryArena();
+	ArenaScope scope(arena);
+	uivector x((ArenaAllocator<unsigned>(&arena)));
+	uivector y((ArenaAllocator<unsigned>(&arena)));
+	explore(matrix, ranks, ind, budget, x, y, local, profile, trace);
+
+	// The local problem is gathered once; scenarios only swap costs and b
+	Eigen::Map<DVec> primals(arena.allocate<double>(y.size()), y.size());
+	Eigen::Map<DVec> b_(arena.allocate<double>(x.size()), x.size());
+	viewSubmatrix(matrix, x, y, [&](const MatrixView& problem) {
+		profile.phase(PHASE_SUBMATRIX);
+		for (unsigned s = 0; s < scenarios.size(); ++s) {
+			ArenaScope scenarioScope(arena);
+			fvector restricted =
+				restrictFunctions(scenarios[s].funs, y, &arena);
+			profile.phase(PHASE_RESTRICT);
+			if (scenarios[s].b.size() == 0) {
+				alg(problem, restricted, 1, primals);
+			} else {
+				for (unsigned i = 0; i < x.size(); ++i) {
+					b_(i) = scenarios[s].b(x[i]);
+				}
+				alg(problem.withB(b_.data()), restricted, 1, primals);
+			}
+			profile.phase(PHASE_ALG);
+			out(s) = primals(0);
+		}
+	});
+	local.primal = out.size() > 0 ? out(0) : 0;
+	local.probes = matrix.getProbes();
+
+	return local;
+}
+
+template <typename O, typename R>
+void explore(const ProbeCounter<O>& matrix, const R& ranks, unsigned ind,
+			 unsigned budget, uivector& x, uivector& y, LocoSolution& local,
+			 QueryProfile& profile, QueryTrace& trace) {
+	SpVec& row = probeBuffers().row;
+	SpVec& col = probeBuffers().col;
+
+	// Rows of X_k are the BFS queue, starting from the dual of highest rank
+	// on column ind; column ind is local column 0, so primals(0) is x_ind
+	x.push_back(maxRank(matrix, ind, ranks));
+	y.push_back(ind);
+	profile.phase(PHASE_MAXRANK);
+	trace.root(x[0]);
+
+	unsigned curr = 0;
+	while (curr < x.size() && !local.truncated) {
+		unsigned end = (unsigned)x.size();
+		profile.visit(curr, end);
+		trace.expand(x[curr], ranks[x[curr]], curr, end);
+		unsigned k = x[curr++];  // Current dual variable index
+		probeRowPattern(matrix, k, row);  // Only indices are read
+
+		// Iterate over nonzero elements in vector of primal variables
+		// corresponding to current dual variable index
+		for (SpVec::InnerIterator itP(row); itP && !local.truncated; ++itP) {
+			unsigned y0 = itP.index();
+			probeColPattern(matrix, y0, col);
+			size_t queued = x.size();
+			exploreCol(col, y0, k, ranks, budget, x, y, local);
+			trace.probe(y0, k, ranks[k], x.size() > queued);
+		}
+	}
+	trace.done(local.messages, local.truncated, (unsigned)x.size(),
+			   (unsigned)y.size());
+
+	profile.phase(PHASE_BFS);
+	profile.record(METRIC_NODES, x.size() + y.size());
+	profile.record(METRIC_EDGES, local.messages);
+	profile.record(METRIC_DEPTH, profile.getDepth());
+	profile.record(METRIC_ROWS, x.size());
+	profile.record(METRIC_COLS, y.size());
+}
+
+template <typename R>
+void exploreCol(const SpVec& col, unsigned y0, unsigned k, const R& ranks,
+				unsigned budget, uivector& x, uivector& y,
+				LocoSolution& local) {
+	bool inY = std::find(y.begin(), y.end(), y0) != y.end();
+
+	// Iterate over nonzero elements in vector of dual variables
+	// corresponding to primal variable index y0
+	for (SpVec::InnerIterator itD(col); itD; ++itD) {
+		if (budget != UNLIMITED && local.messages >= budget) {
+			local.truncated = true;  // Fall back to what we have
+			return;
+		}
+		++local.messages;  // +1 communication!
+
+		if (!inY) {
+			y.push_back(y0);  // If primal index not in y yet, add it
+			inY = true;
+		}
+
+		unsigned x0 = itD.index();
+		if (ranks[x0] < ranks[k] &&
+			std::find(x.begin(), x.end(), x0) == x.end()) {
+			x.push_back(x0);  // If dual index not in x yet, queue it
+		}
+	}
+}
+
+template <typename R>
+unsigned maxRank(const SpVec& x, const R& ranks) {
+	unsigned k = 0;
+	double maxRank = -1;
+
+	// Iterate over nonzero elements in vector of dual variables
+	// Choose index corresponding to variable with highest rank
+	for (SpVec::InnerIterator it(x); it; ++it) {
+		unsigned ind = it.index();
+		double rank = ranks[ind];
+		if (rank > maxRank) {
+			maxRank = rank;
+			k = ind;
+		}
+	}
+
+	return k;
+}
+
+template <typename O, typename R>
+unsigned maxRank(const O& oracle, unsigned col, const R& ranks) {
+	SpVec& duals = probeBuffers().duals;
+	probeColPattern(oracle, col, duals);
+	return maxRank(duals, ranks);
+}
+
+template <typename F>
+fvector restrictFunctions(const F& unrestricted, const uivector& y,
+						  Arena* arena) {
+	unsigned small = (unsigned)y.size();
+	unsigned large = (unsigned)unrestricted.size();
+
+	for (unsigned yi : y) {
+		if (yi >= large) {
+			std::cout << "restrictFunctions ERROR: yi exceeds funs vector\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+
+	fvector restricted(small, fun(), ArenaAllocator<fun>(arena));
+	for (unsigned i = 0; i < small; ++i) {
+		restricted[i] = unrestricted[y[i]];
+	}
+
+	return restricted;
+}
 
 #endif  // LOCO_HPP
 
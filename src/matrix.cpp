@@ -1,24 +1,22 @@
+#include "build.hpp"
 #include "matrix.hpp"
 
-Matrix::Matrix(unsigned r, unsigned c, double p, double noise)
+// Tags separating the random streams derived from one seed
+const uint64_t TAG_ROW_ORDER = 1;
+const uint64_t TAG_COL_ORDER = 2;
+const uint64_t TAG_BASE = 3;
+const uint64_t TAG_NOISE = 4;
+const uint64_t TAG_NOISE_VALUE = 5;
+const uint64_t TAG_B = 7;
+
+Matrix::Matrix(unsigned r, unsigned c, double p, double noise, uint64_t seed)
 	: rows(r), cols(c), cells(r * c) {
-	// Create uniform random real number generator for range [0, 1)
-	unsigned seed =
-		(unsigned)std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine gen(seed);
-	std::uniform_real_distribution<double> dist(0, 1);
+	// Every draw is a counter-based function of the seed and its purpose, so
+	// a seed gives the same instance on any platform and in any order
 
 	// Generate random order for filling rows and columns in matrix
-	uivector rowOrder(rows);
-	uivector colOrder(cols);
-	for (unsigned row = 0; r < rows; ++row) {
-		rowOrder[row] = row;
-	}
-	for (unsigned col = 0; col < cols; ++col) {
-		colOrder[col] = col;
-	}
-	std::shuffle(rowOrder.begin(), rowOrder.end(), gen);
-	std::shuffle(colOrder.begin(), colOrder.end(), gen);
+	Permutation rowOrder(rows, hashKey(seed, TAG_ROW_ORDER));
+	Permutation colOrder(cols, hashKey(seed, TAG_COL_ORDER));
 
 	// Generate (row, col, value) triplets to insert into matrix
 	std::vector<T> triplets;  // Values to insert into matrix
@@ -29,25 +27,28 @@ Matrix::Matrix(unsigned r, unsigned c, double p, double noise)
 			if (col >= cols) {
 				col = 0;
 			}
-			triplets.push_back(T(rowOrder[row], colOrder[col], dist(gen)));
+			triplets.push_back(T((unsigned)rowOrder(row),
+								 (unsigned)colOrder(col),
+								 toUniform(hashKey(seed, TAG_BASE, row))));
 		}
 	} else {
 		for (unsigned row = 0, col = 0; col < cols; ++row, ++col) {
 			if (row >= rows) {
 				row = 0;
 			}
-			triplets.push_back(T(rowOrder[row], colOrder[col], dist(gen)));
+			triplets.push_back(T((unsigned)rowOrder(row),
+								 (unsigned)colOrder(col),
+								 toUniform(hashKey(seed, TAG_BASE, col))));
 		}
 	}
 
 	// Construct constraint matrix
-	matrix = SpMat(rows, cols);
-	matrix.setFromTriplets(triplets.begin(), triplets.end());
+	buildSparse(rows, cols, triplets, matrix);
 
 	// Generate noisy indices (1-D) from sparsity probability
 	uivector noisyIndices;
 	for (unsigned i = 0; i < cells; ++i) {
-		if (dist(gen) < p) {
+		if (toUniform(hashKey(seed, TAG_NOISE, i)) < p) {
 			noisyIndices.push_back(i);
 		}
 	}
@@ -55,12 +56,13 @@ Matrix::Matrix(unsigned r, unsigned c, double p, double noise)
 	// Next, cycle through noisy 1-D indices, adding corresponding triplets
 	triplets.clear();
 	for (unsigned i : noisyIndices) {
-		triplets.push_back(T(toRow(i), toCol(i), dist(gen)));
+		triplets.push_back(T(toRow(i), toCol(i),
+							 toUniform(hashKey(seed, TAG_NOISE_VALUE, i))));
 	}
 
 	// Construct sparsity noise matrix
-	SpMat sparsityMatrix(rows, cols);
-	sparsityMatrix.setFromTriplets(triplets.begin(), triplets.end());
+	SpMat sparsityMatrix;
+	buildSparse(rows, cols, triplets, sparsityMatrix);
 
 	// Add sparsity noise to constraint matrix
 	matrix += sparsityMatrix;
@@ -70,14 +72,24 @@ Matrix::Matrix(unsigned r, unsigned c, double p, double noise)
 		matrix.col(col) /= matrix.col(col).norm();
 	}
 
-	b = matrix * DVec::Random(cols) + noise * DVec::Random(rows);
+	// b = A u + noise v, with u, v uniform in [-1, 1)
+	DVec u(cols), v(rows);
+	for (unsigned col = 0; col < cols; ++col) {
+		u(col) = 2 * toUniform(hashKey(seed, TAG_B, 1, col)) - 1;
+	}
+	for (unsigned row = 0; row < rows; ++row) {
+		v(row) = 2 * toUniform(hashKey(seed, TAG_B, 0, row)) - 1;
+	}
+	b = matrix * u + noise * v;
+	reindex();
 }
 
-Matrix::Matrix(unsigned r, unsigned c, const std::vector<T> triplets, DVec b_)
+Matrix::Matrix(unsigned r, unsigned c, const std::vector<T>& triplets, DVec b_,
+			   Duplicates duplicates, unsigned threads)
 	: rows(r), cols(c), cells(r * c), b(b_) {
 	// Construct constraint matrix
-	matrix = SpMat(rows, cols);
-	matrix.setFromTriplets(triplets.begin(), triplets.end());
+	buildSparse(rows, cols, triplets, matrix, nullptr, duplicates, threads);
+	reindex();
 	// Check vector b matches number of rows (m) of matrix
 	if (b.size() != rows) {
 		std::cout << "Matrix ERROR: b, rows size mismatch!\n" << std::endl;
@@ -85,67 +97,269 @@ Matrix::Matrix(unsigned r, unsigned c, const std::vector<T> triplets, DVec b_)
 	}
 }
 
-Matrix Matrix::getSubmatrix(uivector rows_, uivector cols_) const {
-	checkRows(rows_);
-	checkCols(cols_);
+Matrix::Matrix(SpMat&& m, DVec b_)
+	: rows((unsigned)m.rows()),
+	  cols((unsigned)m.cols()),
+	  cells(rows * cols),
+	  matrix(std::move(m)),
+	  b(b_) {
+	reindex();
+}
 
-	DVec b_ = DVec(rows_.size());  // All b_i corresponding to indices in rows_
-	std::map<unsigned, unsigned> mapCols, mapRows;
-	for (unsigned i = 0; i < cols_.size(); ++i) {
-		mapCols[cols_[i]] = i;
+// Check compressed arrays of lines inner indices in [0, size), ascending
+// within each line, as borrow() reads them in place
+static void checkCompressed(unsigned lines, unsigned size, const int* outer_,
+							const int* inner_, const char* line) {
+	if (outer_[0] != 0) {
+		std::cout << "borrow ERROR: outer must start at 0\n" << std::endl;
+		exit(EXIT_FAILURE);
 	}
-	for (unsigned i = 0; i < rows_.size(); ++i) {
-		mapRows[rows_[i]] = i;
-		b_(i) = b(rows_[i]);
+	for (unsigned l = 0; l < lines; ++l) {
+		if (outer_[l + 1] < outer_[l]) {
+			std::cout << "borrow ERROR: outer must not decrease\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		for (int i = outer_[l]; i < outer_[l + 1]; ++i) {
+			if (inner_[i] < 0 || (unsigned)inner_[i] >= size ||
+				(i > outer_[l] && inner_[i] <= inner_[i - 1])) {
+				std::cout << "borrow ERROR: indices of " << line << " " << l
+					<< " out of range or unsorted\n" << std::endl;
+				exit(EXIT_FAILURE);
+			}
+		}
 	}
+}
 
-	std::vector<T> triplets;    // Values to insert into submatrix
-	for (unsigned c : cols_) {  // Iterate through columns in cols
-		for (SpMat::InnerIterator it(matrix, c); it;
-			 ++it) {  // Iterate through rows in matrix
-			if (std::find(rows_.begin(), rows_.end(), it.row()) !=
-				rows_.end()) {
-				triplets.push_back(
-					T(mapRows[(unsigned)it.row()], mapCols[c], it.value()));
+Matrix Matrix::borrow(unsigned r, unsigned c, const int* outer_,
+					  const int* inner_, const double* values_, DVec b_,
+					  const int* rowOuter_, const int* rowInner_,
+					  const double* rowValues_) {
+	if (b_.size() != r) {
+		std::cout << "borrow ERROR: b, rows size mismatch!\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	// Validate in place: every lookup binary searches sorted lines
+	checkCompressed(c, r, outer_, inner_, "column");
+
+	Matrix borrowed(SpMat(), std::move(b_));
+	borrowed.rows = r;
+	borrowed.cols = c;
+	borrowed.cells = r * c;
+	borrowed.outer = outer_;
+	borrowed.inner = inner_;
+	borrowed.values = values_;
+	if (rowOuter_ != nullptr) {
+		// Rows must hold exactly the entries of the columns
+		checkCompressed(r, c, rowOuter_, rowInner_, "row");
+		bool same = rowOuter_[r] == outer_[c];
+		const SpMap stored = borrowed.store();
+		for (unsigned row = 0; same && row < r; ++row) {
+			for (int i = rowOuter_[row]; same && i < rowOuter_[row + 1];
+				 ++i) {
+				same = borrowed.isOccupied(row, rowInner_[i]) &&
+					stored.coeff(row, rowInner_[i]) == rowValues_[i];
 			}
 		}
+		if (!same) {
+			std::cout << "borrow ERROR: row arrays differ from columns\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		borrowed.rowOuter = rowOuter_;
+		borrowed.rowInner = rowInner_;
+		borrowed.rowValues = rowValues_;
 	}
+	borrowed.reindex();
+	return borrowed;
+}
 
-	return std::move(
-		Matrix((unsigned)rows_.size(), (unsigned)cols_.size(), triplets, b_));
+Matrix Matrix::fromCompressed(unsigned r, unsigned c, const int* outer_,
+							  const int* inner_, const double* values_,
+							  DVec b_) {
+	Matrix owned = borrow(r, c, outer_, inner_, values_, std::move(b_));
+	owned.own();
+	return owned;
 }
 
-DMat Matrix::getDenseSubmatrix(uivector rows_, uivector cols_) const {
-	checkRows(rows_);
-	checkCols(cols_);
+SpMap Matrix::store() const {
+	if (outer != nullptr) {
+		return SpMap(rows, cols, outer[cols], outer, inner, values);
+	}
+	// Owned storage may be uncompressed after coeffRef inserts
+	return SpMap(rows, cols, matrix.nonZeros(), matrix.outerIndexPtr(),
+				 matrix.innerIndexPtr(), matrix.valuePtr(),
+				 matrix.innerNonZeroPtr());
+}
 
-	std::map<unsigned, unsigned> mapCols, mapRows;
-	for (unsigned i = 0; i < cols_.size(); ++i) {
-		mapCols[cols_[i]] = i;
+void Matrix::own() {
+	if (outer != nullptr) {
+		matrix = store();
+		release();
+		indexRows();
 	}
+}
+
+void Matrix::release() {
+	outer = nullptr;
+	inner = nullptr;
+	values = nullptr;
+	if (rowOuter != nullptr) {
+		rowIndexed = true;  // Rows were given to be probed; keep them fast
+		rowOuter = nullptr;
+		rowInner = nullptr;
+		rowValues = nullptr;
+	}
+}
+
+void Matrix::indexRows() {
+	if (rowIndexed && !isBorrowed()) {
+		buildRows(store(), byRow);
+	} else {
+		byRow = SpMatR();
+	}
+}
+
+void Matrix::buildRowIndex() {
+	if (!rowIndexed) {
+		rowIndexed = true;
+		indexRows();
+	}
+}
+
+void Matrix::reindex() {
+	const SpMap stored = store();
+	indexRows();
+	rowDegree.assign(rows, 0);
+	colDegree.assign(cols, 0);
+	for (unsigned c = 0; c < cols; ++c) {
+		for (SpMap::InnerIterator it(stored, c); it; ++it) {
+			++rowDegree[it.row()];
+			++colDegree[c];
+		}
+	}
+	maxRowDegree = rows > 0 ? *std::max_element(rowDegree.begin(),
+												rowDegree.end())
+							: 0;
+	maxColDegree = cols > 0 ? *std::max_element(colDegree.begin(),
+												colDegree.end())
+							: 0;
+}
+
+SpMat Matrix::extract(const uivector& rows_, const uivector& cols_) const {
+	checkRows(rows_);
+	checkCols(cols_);
+	const SpMap stored = store();
+
+	// Scratch maps and triplets live in the current query's arena
+	Arena& arena = queryArena();
+	ArenaScope scope(arena);
+	typedef std::pair<const unsigned, unsigned> Entry;
+	typedef std::map<unsigned, unsigned, std::less<unsigned>,
+					 ArenaAllocator<Entry>>
+		IndexMap;
+	IndexMap mapRows((ArenaAllocator<Entry>(&arena)));
 	for (unsigned i = 0; i < rows_.size(); ++i) {
 		mapRows[rows_[i]] = i;
 	}
 
-	std::vector<T> triplets;    // Values to insert into submatrix
-	for (unsigned c : cols_) {  // Iterate through columns in cols
-		for (SpMat::InnerIterator it(matrix, c); it;
+	std::vector<T, ArenaAllocator<T>> triplets(
+		(ArenaAllocator<T>(&arena)));  // Values to insert into submatrix
+	for (unsigned j = 0; j < cols_.size(); ++j) {  // Columns in cols
+		for (SpMap::InnerIterator it(stored, cols_[j]); it;
 			 ++it) {  // Iterate through rows in matrix
-			if (std::find(rows_.begin(), rows_.end(), it.row()) !=
-				rows_.end()) {
-				triplets.push_back(
-					T(mapRows[(unsigned)it.row()], mapCols[c], it.value()));
+			auto row = mapRows.find((unsigned)it.row());
+			if (row != mapRows.end()) {
+				triplets.push_back(T(row->second, j, it.value()));
 			}
 		}
 	}
 
 	SpMat sparse(rows_.size(), cols_.size());
 	sparse.setFromTriplets(triplets.begin(), triplets.end());
-	return DMat(sparse);
+	return sparse;
+}
+
+Matrix Matrix::getSubmatrix(const uivector& rows_,
+							const uivector& cols_) const {
+	DVec b_ = DVec(rows_.size());  // All b_i corresponding to indices in rows_
+	for (unsigned i = 0; i < rows_.size(); ++i) {
+		b_(i) = b(checkRow(rows_[i]));
+	}
+	return Matrix(extract(rows_, cols_), b_);
+}
+
+DMat Matrix::getDenseSubmatrix(const uivector& rows_,
+							   const uivector& cols_) const {
+	return DMat(extract(rows_, cols_));
+}
+
+MatrixView Matrix::getView(const uivector& rows_,
+						   const uivector& cols_) const {
+	checkRows(rows_);
+	checkCols(cols_);
+	return MatrixView(*this, rows_, cols_);
+}
+
+MatrixView::MatrixView(const Matrix& parent, const uivector& rows_,
+					   const uivector& cols_)
+	: matrix(parent.store()),
+	  b(parent.b),
+	  rows(rows_),
+	  cols(cols_),
+	  remap(queryArena().allocate<Remap>(rows_.size())) {
+	for (unsigned i = 0; i < rows.size(); ++i) {
+		new (remap + i) Remap(rows[i], i);
+	}
+	std::sort(remap, remap + rows.size());
+}
+
+unsigned MatrixView::getNonZeros() const {
+	unsigned nonZeros = 0;
+	for (unsigned j = 0; j < getCols(); ++j) {
+		for (ColIterator it(*this, j); it; ++it) {
+			++nonZeros;
+		}
+	}
+	return nonZeros;
+}
+
+void Matrix::probeRow(unsigned r, SpVec& out) const {
+	checkRow(r);
+	out.resize(cols);  // Keeps allocated capacity
+	if (rowOuter != nullptr) {
+		for (int i = rowOuter[r]; i < rowOuter[r + 1]; ++i) {
+			out.insertBack(rowInner[i]) = rowValues[i];
+		}
+		return;
+	}
+	if (rowIndexed && !isBorrowed()) {
+		for (SpMatR::InnerIterator it(byRow, r); it; ++it) {
+			out.insertBack(it.col()) = it.value();
+		}
+		return;
+	}
+	// Stop once the row's known degree is reached
+	const SpMap stored = store();
+	unsigned degree = rowDegree[r];
+	for (unsigned c = 0; c < cols && (unsigned)out.nonZeros() < degree; ++c) {
+		double value = stored.coeff(r, c);
+		if (value != 0) {
+			out.insertBack(c) = value;
+		}
+	}
+}
+
+void Matrix::probeCol(unsigned c, SpVec& out) const {
+	checkCol(c);
+	out.resize(rows);  // Keeps allocated capacity
+	for (SpMap::InnerIterator it(store(), c); it; ++it) {
+		out.insertBack(it.row()) = it.value();
+	}
 }
 
 unsigned Matrix::checkInd(unsigned ind) const {
-	if (ind > cells) {
+	if (ind >= cells) {
 		std::cout << "checkInd ERROR: ind exceeds number of cells\n"
 			<< std::endl;
 		exit(EXIT_FAILURE);
@@ -154,7 +368,7 @@ unsigned Matrix::checkInd(unsigned ind) const {
 }
 
 unsigned Matrix::checkRow(unsigned r) const {
-	if (r > rows) {
+	if (r >= rows) {
 		std::cout << "checkRow ERROR: row exceeds number of rows\n"
 			<< std::endl;
 		exit(EXIT_FAILURE);
@@ -163,7 +377,7 @@ unsigned Matrix::checkRow(unsigned r) const {
 }
 
 unsigned Matrix::checkCol(unsigned c) const {
-	if (c > cols) {
+	if (c >= cols) {
 		std::cout << "checkCol ERROR: col exceeds number of columns\n"
 			<< std::endl;
 		exit(EXIT_FAILURE);
@@ -171,13 +385,13 @@ unsigned Matrix::checkCol(unsigned c) const {
 	return c;
 }
 
-void Matrix::checkRows(uivector rows_) const {
+void Matrix::checkRows(const uivector& rows_) const {
 	for (unsigned r : rows_) {
 		checkRow(r);
 	}
 }
 
-void Matrix::checkCols(uivector cols_) const {
+void Matrix::checkCols(const uivector& cols_) const {
 	for (unsigned c : cols_) {
 		checkCol(c);
 	}
@@ -186,28 +400,39 @@ void Matrix::checkCols(uivector cols_) const {
 double Matrix::getCell(unsigned r, unsigned c) const {
 	checkRow(r);
 	checkCol(c);
-	return matrix.coeff(r, c);
+	return store().coeff(r, c);
 }
 
 double Matrix::getCell(unsigned ind) const {
 	checkInd(ind);
-	return matrix.coeff(toRow(ind), toCol(ind));
+	return store().coeff(toRow(ind), toCol(ind));
 }
 
 SpVec Matrix::getRow(unsigned r) const {
-	checkRow(r);
-	return matrix.row(r);
+	SpVec row;
+	probeRow(r, row);
+	return row;
 }
 
 SpVec Matrix::getCol(unsigned c) const {
 	checkCol(c);
-	return matrix.col(c);
+	return store().col(c);
+}
+
+DVec Matrix::getB() const {
+	return b;
+}
+
+double Matrix::getB(unsigned r) const {
+	checkRow(r);
+	return b(r);
 }
 
 std::vector<T> Matrix::getTriplets() const {
+	const SpMap stored = store();
 	std::vector<T> triplets;
-	for (unsigned i = 0; i < matrix.outerSize(); ++i) {
-		for (SpMat::InnerIterator it(matrix, i); it; ++it) {
+	for (unsigned i = 0; i < stored.outerSize(); ++i) {
+		for (SpMap::InnerIterator it(stored, i); it; ++it) {
 			triplets.push_back(
 				T((unsigned)it.row(), (unsigned)it.col(), it.value()));
 		}
@@ -218,41 +443,115 @@ std::vector<T> Matrix::getTriplets() const {
 void Matrix::setCell(unsigned r, unsigned c, double val) {
 	checkRow(r);
 	checkCol(c);
+	own();
+	bool wasOccupied = isOccupied(r, c);
 	matrix.coeffRef(r, c) = val;
 	if (val < EPSILON && val > -EPSILON) {
 		matrix.prune(0.0);
+		reindex();  // Pruning drops every zero, not only this one
+	} else {
+		if (rowIndexed) {
+			byRow.coeffRef(r, c) = val;
+		}
+		if (!wasOccupied) {
+			maxRowDegree = std::max(maxRowDegree, ++rowDegree[r]);
+			maxColDegree = std::max(maxColDegree, ++colDegree[c]);
+		}
+	}
+}
+
+void Matrix::setCells(const std::vector<T>& updates) {
+	std::map<std::pair<unsigned, unsigned>, double> cells_;
+	for (const T& t : updates) {
+		checkRow(t.row());
+		checkCol(t.col());
+		cells_[std::make_pair((unsigned)t.row(), (unsigned)t.col())] =
+			t.value();
+	}
+
+	// Keep every entry not being set, then add the new nonzeros
+	const SpMap stored = store();
+	std::vector<T> triplets;
+	triplets.reserve(stored.nonZeros() + cells_.size());
+	for (unsigned col = 0; col < cols; ++col) {
+		for (SpMap::InnerIterator it(stored, col); it; ++it) {
+			if (cells_.count(std::make_pair((unsigned)it.row(), col)) == 0) {
+				triplets.push_back(T((unsigned)it.row(), col, it.value()));
+			}
+		}
 	}
+	for (auto& cell : cells_) {
+		if (cell.second != 0) {
+			triplets.push_back(
+				T(cell.first.first, cell.first.second, cell.second));
+		}
+	}
+	SpMat updated(rows, cols);
+	updated.setFromTriplets(triplets.begin(), triplets.end());
+	matrix.swap(updated);
+	release();  // Now owned; borrowed arrays are no longer read
+	reindex();
 }
 
 void Matrix::clearCell(unsigned r, unsigned c) {
 	checkRow(r);
 	checkCol(c);
+	own();
 	matrix.coeffRef(r, c) = 0;
 	matrix.prune(0.0);
+	reindex();
 }
 
 bool Matrix::isOccupied(unsigned r, unsigned c) const {
 	checkRow(r);
 	checkCol(c);
-	for (SpMat::InnerIterator it(matrix, c); it; ++it) {
-		if (it.row() == r) {
-			return true;
-		}
-	}
-	return false;
+	const SpMap stored = store();
+	const int* begin = stored.innerIndexPtr() + stored.outerIndexPtr()[c];
+	const int* end = stored.innerNonZeroPtr() != nullptr
+		? begin + stored.innerNonZeroPtr()[c]
+		: stored.innerIndexPtr() + stored.outerIndexPtr()[c + 1];
+	return std::binary_search(begin, end, (int)r);
 }
 
 void Matrix::printDense() const {
-	DMat dense(matrix);
+	DMat dense(store());
 	Eigen::IOFormat clean(3, 0, ", ", "\n", "[", "]");
 	std::cout << "Printing " << rows << "x" << cols << " dense matrix: \n";
 	std::cout << dense.format(clean) << std::endl;
 }
 
+// Bytes held by owned sparse storage, spare capacity included
+template <typename S>
+static size_t sparseBytes(const S& sparse) {
+	size_t outerBytes = ((size_t)sparse.outerSize() + 1) * sizeof(int);
+	if (sparse.innerNonZeroPtr() != nullptr) {
+		outerBytes += (size_t)sparse.outerSize() * sizeof(int);
+	}
+	return outerBytes + (size_t)sparse.data().allocatedSize() *
+		(sizeof(double) + sizeof(int));
+}
+
+MatrixMemory Matrix::getMemory() const {
+	MatrixMemory m;
+	m.storage = sparseBytes(matrix);
+	m.borrowed = outer == nullptr ? 0 : ((size_t)cols + 1) * sizeof(int) +
+		(size_t)outer[cols] * (sizeof(double) + sizeof(int));
+	if (rowOuter != nullptr) {
+		m.borrowed += ((size_t)rows + 1) * sizeof(int) +
+			(size_t)rowOuter[rows] * (sizeof(double) + sizeof(int));
+	}
+	m.rhs = (size_t)b.size() * sizeof(double);
+	m.degrees = (rowDegree.capacity() + colDegree.capacity()) *
+		sizeof(unsigned);
+	m.rowMajor = rowIndexed && !isBorrowed() ? sparseBytes(byRow) : 0;
+	return m;
+}
+
 void Matrix::printSparse() const {
 	std::cout << "Printing " << rows << "x" << cols << " sparse matrix: \n";
-	for (unsigned i = 0; i < matrix.outerSize(); ++i) {
-		for (SpMat::InnerIterator it(matrix, i); it; ++it) {
+	const SpMap stored = store();
+	for (unsigned i = 0; i < stored.outerSize(); ++i) {
+		for (SpMap::InnerIterator it(stored, i); it; ++it) {
 			std::cout << "( " << it.row() << ", \t" << it.col() << ", \t"
 				<< it.value() << " )\n";
 		}
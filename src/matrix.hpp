@@ -13,25 +13,54 @@
 #include <map>
 #include <random>
 #include <vector>
+#include "arena.hpp"
+#include "random.hpp"
 
 // Typedefs and constants
 typedef Eigen::MatrixXd DMat;               // Dynamic-sized dense matrix
 typedef Eigen::VectorXd DVec;               // Dynamic-sized dense col vector
 typedef Eigen::RowVectorXd DRowVec;         // Dynamic-sized dense row vector
 typedef Eigen::SparseMatrix<double> SpMat;  // Column-major sparse matrix
+typedef Eigen::Map<const SpMat> SpMap;      // Read-only sparse matrix view
+typedef Eigen::SparseMatrix<double, Eigen::RowMajor> SpMatR;  // Row-major
 typedef Eigen::SparseVector<double> SpVec;  // Sparse vector
 typedef Eigen::Triplet<double> T;           // Triplet for filling matrix
-typedef std::vector<unsigned> uivector;
+typedef std::vector<unsigned, ArenaAllocator<unsigned>> uivector;
 const unsigned DEFAULT_SIZE = 100;
 const double SPARSITY_BASE = 5;
 const double DEFAULT_NOISE = .01;
 const double EPSILON = std::numeric_limits<double>::epsilon() * 3;
 
+// What bulk construction does with triplets on the same cell
+enum Duplicates {
+	DUPLICATES_SUM,   // Add them in input order, as setFromTriplets does
+	DUPLICATES_LAST,  // Keep the last one given
+	DUPLICATES_ERROR  // Reject the input
+};
+
 inline bool checkError(double a, double b) {
 	return fabs(a - b) < EPSILON;
 }
 
+// Bytes held by a Matrix, by component
+typedef struct {
+	size_t storage;   // Owned sparse indices and values, spare capacity too
+	size_t borrowed;  // Caller-owned arrays read in place, not owned
+	size_t rhs;       // Vector b
+	size_t degrees;   // Row and column degree arrays
+	size_t rowMajor;  // Row-major copy serving row probes
+} MatrixMemory;
+
+// Bytes held by a sparse vector's storage, spare capacity included
+inline size_t vectorBytes(const SpVec& v) {
+	return (size_t)v.data().allocatedSize() * (sizeof(double) + sizeof(int));
+}
+
+class MatrixView;
+
 class Matrix {
+	friend class MatrixView;
+
 private:
 	unsigned rows;
 	unsigned cols;
@@ -39,6 +68,27 @@ private:
 	SpMat matrix;
 	DVec b;
 
+	// Caller-owned CSC arrays read in place of matrix; null when owned
+	const int* outer = nullptr;
+	const int* inner = nullptr;
+	const double* values = nullptr;
+	// Caller-owned CSR arrays of the same entries serving row probes; null
+	// unless given to borrow()
+	const int* rowOuter = nullptr;
+	const int* rowInner = nullptr;
+	const double* rowValues = nullptr;
+
+	// Row-major copy of owned storage, so a row probe reads only its row;
+	// kept by every setter once buildRowIndex() asks for it, else empty
+	bool rowIndexed = false;
+	SpMatR byRow;
+
+	// Nonzeros of every row and column and their maxima, kept by every
+	// constructor and setter
+	std::vector<unsigned> rowDegree, colDegree;
+	unsigned maxRowDegree = 0;
+	unsigned maxColDegree = 0;
+
 	// Convert 1D index to 2D row, column
 	inline int toRow(unsigned ind) const {
 		return ind / cols;
@@ -55,16 +105,66 @@ private:
 	unsigned checkInd(unsigned ind) const;
 	unsigned checkRow(unsigned r) const;
 	unsigned checkCol(unsigned c) const;
-	void checkRows(uivector rows) const;
-	void checkCols(uivector cols) const;
+	void checkRows(const uivector& rows) const;
+	void checkCols(const uivector& cols) const;
+
+	// Take ownership of prepared storage
+	Matrix(SpMat&& m, DVec b_);
+	// Storage every read goes through, owned or borrowed
+	SpMap store() const;
+	// Copy borrowed arrays into owned storage before a write
+	void own();
+	// Stop reading borrowed arrays; borrowed rows become a row index
+	void release();
+	// Rebuild the row-major copy, if one is kept, from storage, O(nnz)
+	void indexRows();
+	// Rebuild the degrees and the row-major copy from storage, O(nnz)
+	void reindex();
+	// Copy entries on rows x cols into a new local sparse matrix
+	SpMat extract(const uivector& rows, const uivector& cols) const;
 
 public:
-	Matrix(unsigned r, unsigned c, double p, double noise = DEFAULT_NOISE);
+	// Random instances are a function of the seed; the others seed randomly
+	Matrix(unsigned r, unsigned c, double p, double noise, uint64_t seed);
+	Matrix(unsigned r, unsigned c, double p, double noise = DEFAULT_NOISE)
+		: Matrix(r, c, p, noise, clockSeed()) {}
 	Matrix() : Matrix(DEFAULT_SIZE) {}
 	Matrix(unsigned n) : Matrix(n, n) {}
 	Matrix(unsigned r, unsigned c)
 		: Matrix(r, c, SPARSITY_BASE / c, DEFAULT_NOISE) {}
-	Matrix(unsigned r, unsigned c, const std::vector<T> triplets, DVec b_);
+	// Default sparsity and noise from a seed; named, since a constructor
+	// taking (r, c, seed) would be ambiguous with (r, c, p) for int seeds
+	static Matrix seeded(unsigned r, unsigned c, uint64_t seed) {
+		return Matrix(r, c, SPARSITY_BASE / c, DEFAULT_NOISE, seed);
+	}
+	// Built in parallel by buildSparse (build.hpp); threads 0 uses every core
+	Matrix(unsigned r, unsigned c, const std::vector<T>& triplets, DVec b_,
+		   Duplicates duplicates = DUPLICATES_SUM, unsigned threads = 0);
+
+	/**
+	 * Wrap caller-owned CSC arrays without copying them
+	 * outer holds c + 1 offsets into inner (row indices, ascending within
+	 * each column) and values. The arrays must stay unchanged and outlive
+	 * the matrix and every copy, view and snapshot taken from it; copies
+	 * share the arrays. The first setter copies them into owned storage,
+	 * leaving the caller's arrays untouched. A CSR buffer of A is the CSC
+	 * buffer of its transpose. Nothing is copied: row probes scan the
+	 * columns, unless the CSR arrays of the same entries are also given
+	 * (rowOuter_ holding r + 1 offsets), which they then read in place
+	 * under the same lifetime rules.
+	 */
+	static Matrix borrow(unsigned r, unsigned c, const int* outer_,
+						 const int* inner_, const double* values_, DVec b_,
+						 const int* rowOuter_ = nullptr,
+						 const int* rowInner_ = nullptr,
+						 const double* rowValues_ = nullptr);
+	inline bool isBorrowed() const {
+		return outer != nullptr;
+	}
+	// Copy CSC arrays laid out as for borrow() into owned storage
+	static Matrix fromCompressed(unsigned r, unsigned c, const int* outer_,
+								 const int* inner_, const double* values_,
+								 DVec b_);
 
 	// Getters
 	inline unsigned getRows() const {
@@ -81,12 +181,39 @@ public:
 	SpVec getRow(unsigned r) const;
 	SpVec getCol(unsigned c) const;
 	DVec getB() const;
+	double getB(unsigned r) const;
 	std::vector<T> getTriplets() const;
-	Matrix getSubmatrix(uivector rows, uivector cols) const;
-	DMat getDenseSubmatrix(uivector rows, uivector cols) const;
+	Matrix getSubmatrix(const uivector& rows, const uivector& cols) const;
+	DMat getDenseSubmatrix(const uivector& rows, const uivector& cols) const;
+	MatrixView getView(const uivector& rows, const uivector& cols) const;
+	inline unsigned getRowDegree(unsigned r) const {
+		return rowDegree[checkRow(r)];
+	}
+	inline unsigned getColDegree(unsigned c) const {
+		return colDegree[checkCol(c)];
+	}
+	// Most nonzeros in any row (d) and in any column
+	inline unsigned getMaxRowDegree() const {
+		return maxRowDegree;
+	}
+	inline unsigned getMaxColDegree() const {
+		return maxColDegree;
+	}
+
+	// Probe into caller-owned buffers, reusing their storage. Without a
+	// row index a row probe binary searches every column until the row's
+	// degree is reached
+	void probeRow(unsigned r, SpVec& out) const;
+	void probeCol(unsigned c, SpVec& out) const;
+	// Keep a row-major copy so row probes read only their row, at another
+	// nnz indices and values. Skipped while storage is borrowed, so
+	// borrow() stays zero-copy; the first setter builds it on owning
+	void buildRowIndex();
 
 	// Setters
 	void setCell(unsigned r, unsigned c, double val);
+	// Set many cells in one pass; later entries win and zeros clear a cell
+	void setCells(const std::vector<T>& updates);
 	void setCell(unsigned ind, double val) {
 		setCell(toRow(ind), toCol(ind), val);
 	}
@@ -96,12 +223,107 @@ public:
 	}
 
 	// Utilities
+	// Binary search of column c, whose rows are kept ascending
 	bool isOccupied(unsigned r, unsigned c) const;
 	bool isOccupied(unsigned ind) const {
 		return isOccupied(toRow(ind), toCol(ind));
 	}
 	void printDense() const;
 	void printSparse() const;
+	MatrixMemory getMemory() const;
+};
+
+/**
+ * Non-owning view of the submatrix of a Matrix on rows x cols
+ * Reads the parent's storage directly through a local row remap, so a
+ * local problem needs no copy. The parent, the index lists and the arena
+ * scope the view was created in must outlive it.
+ */
+class MatrixView {
+private:
+	typedef std::pair<unsigned, unsigned> Remap;  // (parent row, local row)
+
+	SpMap matrix;
+	const DVec& b;
+	const uivector& rows;
+	const uivector& cols;
+	// One per local row, sorted by parent row; in the arena, so copies such
+	// as withB() share it
+	Remap* remap;
+	const double* localB = nullptr;  // Replaces b when set, by local row
+
+public:
+	MatrixView(const Matrix& parent, const uivector& rows_,
+			   const uivector& cols_);
+
+	// Same view with b replaced by localB[i] for local row i; localB must
+	// outlive the copy
+	MatrixView withB(const double* localB_) const {
+		MatrixView view(*this);
+		view.localB = localB_;
+		return view;
+	}
+
+	inline unsigned getRows() const {
+		return (unsigned)rows.size();
+	}
+	inline unsigned getCols() const {
+		return (unsigned)cols.size();
+	}
+	double getCell(unsigned i, unsigned j) const {
+		return matrix.coeff(rows[i], cols[j]);
+	}
+	double getB(unsigned i) const {
+		return localB != nullptr ? localB[i] : b(rows[i]);
+	}
+	unsigned getNonZeros() const;
+
+	// Nonzeros of local column j with local row indices, in parent row order
+	class ColIterator {
+	private:
+		SpMap::InnerIterator it;
+		const Remap* pos;
+		const Remap* end;
+		bool valid;
+
+		void skip() {
+			// Both sides are sorted by parent row, so search only forwards
+			for (; it; ++it) {
+				pos = std::lower_bound(pos, end,
+									   Remap((unsigned)it.row(), 0));
+				if (pos == end) {
+					break;
+				}
+				if (pos->first == (unsigned)it.row()) {
+					return;
+				}
+			}
+			valid = false;
+		}
+
+	public:
+		ColIterator(const MatrixView& view, unsigned j)
+			: it(view.matrix, view.cols[j]),
+			  pos(view.remap),
+			  end(view.remap + view.rows.size()),
+			  valid(true) {
+			skip();
+		}
+		ColIterator& operator++() {
+			++it;
+			skip();
+			return *this;
+		}
+		explicit operator bool() const {
+			return valid;
+		}
+		unsigned row() const {
+			return pos->second;
+		}
+		double value() const {
+			return it.value();
+		}
+	};
 };
 
 #endif  // MATRIX_HPP
@@ -0,0 +1,59 @@
+#include "memory.hpp"
+#if defined(_WIN32)
+#include <windows.h>
+#include <psapi.h>
+#elif defined(__linux__)
+#include <algorithm>
+#include <cstdio>
+#include <sys/resource.h>
+#include <unistd.h>
+#endif
+
+#if defined(_WIN32)
+size_t residentBytes() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+							  sizeof(counters))) {
+		return 0;
+	}
+	return counters.WorkingSetSize;
+}
+
+size_t peakResidentBytes() {
+	PROCESS_MEMORY_COUNTERS counters;
+	if (!GetProcessMemoryInfo(GetCurrentProcess(), &counters,
+							  sizeof(counters))) {
+		return 0;
+	}
+	return counters.PeakWorkingSetSize;
+}
+#elif defined(__linux__)
+size_t residentBytes() {
+	// Second field of statm: resident pages
+	FILE* statm = std::fopen("/proc/self/statm", "r");
+	if (statm == nullptr) {
+		return 0;
+	}
+	unsigned long size = 0, resident = 0;
+	int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+	std::fclose(statm);
+	return read == 2 ? resident * (size_t)sysconf(_SC_PAGESIZE) : 0;
+}
+
+size_t peakResidentBytes() {
+	rusage usage;
+	if (getrusage(RUSAGE_SELF, &usage) != 0) {
+		return 0;
+	}
+	// Reported in KiB, and sampled less often than statm
+	return std::max((size_t)usage.ru_maxrss * 1024, residentBytes());
+}
+#else
+size_t residentBytes() {
+	return 0;
+}
+
+size_t peakResidentBytes() {
+	return 0;
+}
+#endif
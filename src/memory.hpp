@@ -0,0 +1,12 @@
+#ifndef MEMORY_HPP
+#define MEMORY_HPP
+
+// Includes
+#include <cstddef>
+
+// Resident memory of the whole process, in bytes; zero where the system
+// does not report it (Linux and Windows do)
+size_t residentBytes();
+size_t peakResidentBytes();
+
+#endif  // MEMORY_HPP
@@ -0,0 +1,245 @@
+#ifndef ORACLE_HPP
+#define ORACLE_HPP
+
+// Includes
+#include "matrix.hpp"
+
+/**
+ * Probe oracles give neighbourhood access to a constraint matrix without
+ * assuming how (or whether) it is stored. Anything with the members below
+ * can be passed to the templated loco() and maxRank():
+ *
+ *      unsigned getRows() const;           - number of dual variables
+ *      unsigned getCols() const;           - number of primal variables
+ *      SpVec getRow(unsigned r) const;     - nonzeros of row r
+ *      SpVec getCol(unsigned c) const;     - nonzeros of column c
+ *      double getB(unsigned r) const;      - right hand side b_r
+ *      void probeRow(unsigned r, SpVec& out) const;
+ *      void probeCol(unsigned c, SpVec& out) const;
+ *                                          - getRow/getCol into a reused
+ *                                            buffer, so the hot path of a
+ *                                            query need not allocate
+ *
+ * Exploration reads only which entries are nonzero, through the free
+ * functions probeRowPattern and probeColPattern. They default to the probes
+ * above; backends with an index-only layout (see CompressedOracle)
+ * overload them and may leave placeholder values in out.
+ *
+ * Matrix satisfies this directly, so the in-memory path has no indirection.
+ * Oracle is the runtime-polymorphic form for backends picked at run time
+ * (mmapped files, generated instances, shards); MatrixOracle adapts a
+ * Matrix to it. Both adapters are final, so calls through a concrete type
+ * are devirtualized and inlined.
+ */
+class Oracle {
+public:
+	virtual ~Oracle() {}
+	virtual unsigned getRows() const = 0;
+	virtual unsigned getCols() const = 0;
+	virtual SpVec getRow(unsigned r) const = 0;
+	virtual SpVec getCol(unsigned c) const = 0;
+	virtual double getB(unsigned r) const = 0;
+	virtual void probeRow(unsigned r, SpVec& out) const {
+		out = getRow(r);
+	}
+	virtual void probeCol(unsigned c, SpVec& out) const {
+		out = getCol(c);
+	}
+};
+
+// In-memory adapter for Matrix
+class MatrixOracle final : public Oracle {
+private:
+	const Matrix& matrix;
+
+public:
+	MatrixOracle(const Matrix& m) : matrix(m) {}
+
+	unsigned getRows() const override {
+		return matrix.getRows();
+	}
+	unsigned getCols() const override {
+		return matrix.getCols();
+	}
+	SpVec getRow(unsigned r) const override {
+		return matrix.getRow(r);
+	}
+	SpVec getCol(unsigned c) const override {
+		return matrix.getCol(c);
+	}
+	double getB(unsigned r) const override {
+		return matrix.getB(r);
+	}
+	void probeRow(unsigned r, SpVec& out) const override {
+		matrix.probeRow(r, out);
+	}
+	void probeCol(unsigned c, SpVec& out) const override {
+		matrix.probeCol(c, out);
+	}
+	const Matrix& getMatrix() const {
+		return matrix;
+	}
+};
+
+// Counts row and column probes made through any oracle type O
+// Not thread safe: use one counter per query
+template <typename O>
+class ProbeCounter final : public Oracle {
+private:
+	const O& oracle;
+	mutable unsigned rowProbes;
+	mutable unsigned colProbes;
+
+public:
+	ProbeCounter(const O& o) : oracle(o), rowProbes(0), colProbes(0) {}
+
+	unsigned getRows() const override {
+		return oracle.getRows();
+	}
+	unsigned getCols() const override {
+		return oracle.getCols();
+	}
+	SpVec getRow(unsigned r) const override {
+		++rowProbes;
+		return oracle.getRow(r);
+	}
+	SpVec getCol(unsigned c) const override {
+		++colProbes;
+		return oracle.getCol(c);
+	}
+	double getB(unsigned r) const override {
+		return oracle.getB(r);
+	}
+	void probeRow(unsigned r, SpVec& out) const override {
+		++rowProbes;
+		oracle.probeRow(r, out);
+	}
+	void probeCol(unsigned c, SpVec& out) const override {
+		++colProbes;
+		oracle.probeCol(c, out);
+	}
+
+	const O& getOracle() const {
+		return oracle;
+	}
+	unsigned getRowProbes() const {
+		return rowProbes;
+	}
+	unsigned getColProbes() const {
+		return colProbes;
+	}
+	unsigned getProbes() const {
+		return rowProbes + colProbes;
+	}
+	void countRowProbes(unsigned num) const {
+		rowProbes += num;
+	}
+	void countColProbes(unsigned num) const {
+		colProbes += num;
+	}
+};
+
+// Nonzeros of row r / column c for exploration; values may be placeholders
+template <typename O>
+void probeRowPattern(const O& oracle, unsigned r, SpVec& out) {
+	oracle.probeRow(r, out);
+}
+
+template <typename O>
+void probeColPattern(const O& oracle, unsigned c, SpVec& out) {
+	oracle.probeCol(c, out);
+}
+
+template <typename O>
+void probeRowPattern(const ProbeCounter<O>& counter, unsigned r, SpVec& out) {
+	counter.countRowProbes(1);
+	probeRowPattern(counter.getOracle(), r, out);
+}
+
+template <typename O>
+void probeColPattern(const ProbeCounter<O>& counter, unsigned c, SpVec& out) {
+	counter.countColProbes(1);
+	probeColPattern(counter.getOracle(), c, out);
+}
+
+// Build the local submatrix on rows_ x cols_ by probing each column once
+template <typename O>
+Matrix extractSubmatrix(const O& oracle, const uivector& rows_,
+						const uivector& cols_) {
+	std::map<unsigned, unsigned> mapRows;
+	DVec b_ = DVec(rows_.size());
+	for (unsigned i = 0; i < rows_.size(); ++i) {
+		mapRows[rows_[i]] = i;
+		b_(i) = oracle.getB(rows_[i]);
+	}
+
+	std::vector<T> triplets;
+	for (unsigned j = 0; j < cols_.size(); ++j) {
+		SpVec col = oracle.getCol(cols_[j]);
+		for (SpVec::InnerIterator it(col); it; ++it) {
+			auto row = mapRows.find((unsigned)it.index());
+			if (row != mapRows.end()) {
+				triplets.push_back(T(row->second, j, it.value()));
+			}
+		}
+	}
+
+	return Matrix((unsigned)rows_.size(), (unsigned)cols_.size(), triplets,
+				  b_);
+}
+
+// Stored matrices extract straight from their own storage
+inline Matrix extractSubmatrix(const Matrix& matrix, const uivector& rows_,
+							   const uivector& cols_) {
+	return matrix.getSubmatrix(rows_, cols_);
+}
+
+inline Matrix extractSubmatrix(const MatrixOracle& oracle,
+							   const uivector& rows_, const uivector& cols_) {
+	return oracle.getMatrix().getSubmatrix(rows_, cols_);
+}
+
+template <typename O>
+Matrix extractSubmatrix(const ProbeCounter<O>& counter, const uivector& rows_,
+						const uivector& cols_) {
+	counter.countColProbes((unsigned)cols_.size());
+	return extractSubmatrix(counter.getOracle(), rows_, cols_);
+}
+
+// Call fn with a view of the local problem on rows_ x cols_. Stored
+// matrices are viewed in place; other backends are extracted first.
+template <typename O, typename Fn>
+void viewSubmatrix(const O& oracle, const uivector& rows_,
+				   const uivector& cols_, Fn fn) {
+	Matrix local = extractSubmatrix(oracle, rows_, cols_);
+	uivector localRows(rows_.size(), 0, rows_.get_allocator());
+	uivector localCols(cols_.size(), 0, cols_.get_allocator());
+	for (unsigned i = 0; i < localRows.size(); ++i) {
+		localRows[i] = i;
+	}
+	for (unsigned j = 0; j < localCols.size(); ++j) {
+		localCols[j] = j;
+	}
+	fn(local.getView(localRows, localCols));
+}
+
+template <typename Fn>
+void viewSubmatrix(const Matrix& matrix, const uivector& rows_,
+				   const uivector& cols_, Fn fn) {
+	fn(matrix.getView(rows_, cols_));
+}
+
+template <typename Fn>
+void viewSubmatrix(const MatrixOracle& oracle, const uivector& rows_,
+				   const uivector& cols_, Fn fn) {
+	fn(oracle.getMatrix().getView(rows_, cols_));
+}
+
+template <typename O, typename Fn>
+void viewSubmatrix(const ProbeCounter<O>& counter, const uivector& rows_,
+				   const uivector& cols_, Fn fn) {
+	counter.countColProbes((unsigned)cols_.size());
+	viewSubmatrix(counter.getOracle(), rows_, cols_, fn);
+}
+
+#endif  // ORACLE_HPP
@@ -0,0 +1,171 @@
+#include "pattern.hpp"
+
+CompressedPattern::CompressedPattern(const Matrix& matrix)
+	: rows(matrix.getRows()), cols(matrix.getCols()), nonZeros(0) {
+	// Column lists come out sorted; bucket them by row for the row lists,
+	// which visits columns in order and so keeps each row sorted too
+	std::vector<unsigned> colIndices, colLines(cols + 1, 0);
+	std::vector<unsigned> rowCount(rows + 1, 0);
+	SpVec line;
+	for (unsigned c = 0; c < cols; ++c) {
+		matrix.probeCol(c, line);
+		for (SpVec::InnerIterator it(line); it; ++it) {
+			colIndices.push_back((unsigned)it.index());
+			++rowCount[it.index() + 1];
+		}
+		colLines[c + 1] = (unsigned)colIndices.size();
+	}
+	nonZeros = (unsigned)colIndices.size();
+
+	std::vector<unsigned> rowLines(rowCount);
+	for (unsigned r = 0; r < rows; ++r) {
+		rowLines[r + 1] += rowLines[r];
+	}
+	std::vector<unsigned> rowIndices(nonZeros), fill(rowLines);
+	for (unsigned c = 0; c < cols; ++c) {
+		for (unsigned i = colLines[c]; i < colLines[c + 1]; ++i) {
+			rowIndices[fill[colIndices[i]]++] = c;
+		}
+	}
+
+	encode(colIndices, colLines, colBytes, colStart);
+	encode(rowIndices, rowLines, rowBytes, rowStart);
+}
+
+void CompressedPattern::encode(const std::vector<unsigned>& indices,
+							   const std::vector<unsigned>& start,
+							   Bytes& bytes, std::vector<unsigned>& offsets) {
+	offsets.assign(start.size(), 0);
+	bytes.reserve(indices.size() * 2);
+	for (unsigned l = 0; l + 1 < start.size(); ++l) {
+		unsigned prev = 0;
+		for (unsigned i = start[l]; i < start[l + 1]; ++i) {
+			unsigned gap = indices[i] - prev;  // First index is its own gap
+			prev = indices[i];
+			while (gap >= 0x80) {
+				bytes.push_back((uint8_t)(gap | 0x80));
+				gap >>= 7;
+			}
+			bytes.push_back((uint8_t)gap);
+		}
+		if (bytes.size() > std::numeric_limits<unsigned>::max()) {
+			std::cout << "CompressedPattern ERROR: pattern exceeds 4 GiB\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+		offsets[l + 1] = (unsigned)bytes.size();
+	}
+	bytes.shrink_to_fit();
+}
+
+CompressedPattern::Iterator CompressedPattern::row(unsigned r) const {
+	if (r >= rows) {
+		std::cout << "CompressedPattern ERROR: row exceeds number of rows\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	const uint8_t* base = rowBytes.data();
+	return Iterator(base + rowStart[r], base + rowStart[r + 1]);
+}
+
+CompressedPattern::Iterator CompressedPattern::col(unsigned c) const {
+	if (c >= cols) {
+		std::cout << "CompressedPattern ERROR: col exceeds number of columns\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	const uint8_t* base = colBytes.data();
+	return Iterator(base + colStart[c], base + colStart[c + 1]);
+}
+
+void CompressedPattern::probeRow(unsigned r, SpVec& out) const {
+	Iterator it = row(r);
+	out.resize(cols);  // Keeps allocated capacity
+	for (; it; ++it) {
+		out.insertBack(it.index()) = 1;
+	}
+}
+
+void CompressedPattern::probeCol(unsigned c, SpVec& out) const {
+	Iterator it = col(c);
+	out.resize(rows);  // Keeps allocated capacity
+	for (; it; ++it) {
+		out.insertBack(it.index()) = 1;
+	}
+}
+
+size_t CompressedPattern::getBytes() const {
+	return rowBytes.size() + colBytes.size() +
+		(rowStart.size() + colStart.size()) * sizeof(unsigned);
+}
+
+size_t CompressedPattern::getUncompressedBytes() const {
+	// Inner and outer index arrays of a CSC and a CSR copy
+	return (2 * (size_t)nonZeros + rows + cols + 2) * sizeof(int);
+}
+
+CompressedOracle::CompressedOracle(const Matrix& m)
+	: pattern(m), colFirst(m.getCols() + 1, 0), b(m.getB()) {
+	values.reserve(pattern.getNonZeros());
+	SpVec line;
+	for (unsigned c = 0; c < m.getCols(); ++c) {
+		m.probeCol(c, line);
+		for (SpVec::InnerIterator it(line); it; ++it) {
+			values.push_back(it.value());
+		}
+		colFirst[c + 1] = (unsigned)values.size();
+	}
+}
+
+void CompressedOracle::probeRow(unsigned r, SpVec& out) const {
+	out.resize(pattern.getCols());  // Keeps allocated capacity
+	for (CompressedPattern::Iterator it = pattern.row(r); it; ++it) {
+		unsigned c = it.index(), i = colFirst[c];
+		for (CompressedPattern::Iterator at = pattern.col(c); at.index() != r;
+			 ++at) {
+			++i;
+		}
+		out.insertBack(c) = values[i];
+	}
+}
+
+void CompressedOracle::probeCol(unsigned c, SpVec& out) const {
+	out.resize(pattern.getRows());  // Keeps allocated capacity
+	unsigned i = colFirst[c];
+	for (CompressedPattern::Iterator it = pattern.col(c); it; ++it, ++i) {
+		out.insertBack(it.index()) = values[i];
+	}
+}
+
+Matrix CompressedOracle::getSubmatrix(const uivector& rows_,
+									  const uivector& cols_) const {
+	// Local row of each row, sorted by row for a binary search per entry
+	typedef std::pair<unsigned, unsigned> Remap;
+	std::vector<Remap> remap;
+	DVec b_(rows_.size());
+	for (unsigned i = 0; i < rows_.size(); ++i) {
+		remap.push_back(Remap(rows_[i], i));
+		b_(i) = b(rows_[i]);
+	}
+	std::sort(remap.begin(), remap.end());
+
+	std::vector<T> triplets;
+	for (unsigned j = 0; j < cols_.size(); ++j) {
+		unsigned i = colFirst[cols_[j]];
+		for (CompressedPattern::Iterator it = pattern.col(cols_[j]); it;
+			 ++it, ++i) {
+			auto found = std::lower_bound(remap.begin(), remap.end(),
+										  Remap(it.index(), 0));
+			if (found != remap.end() && found->first == it.index()) {
+				triplets.push_back(T(found->second, j, values[i]));
+			}
+		}
+	}
+	return Matrix((unsigned)rows_.size(), (unsigned)cols_.size(), triplets,
+				  b_);
+}
+
+size_t CompressedOracle::getBytes() const {
+	return pattern.getBytes() + values.capacity() * sizeof(double) +
+		colFirst.capacity() * sizeof(unsigned) + b.size() * sizeof(double);
+}
@@ -0,0 +1,160 @@
+#ifndef PATTERN_HPP
+#define PATTERN_HPP
+
+// Includes
+#include <cstdint>
+#include "oracle.hpp"
+
+/**
+ * Sparsity pattern of a Matrix with delta + varint coded indices
+ * Every row and column is stored as the gaps between its ascending nonzero
+ * indices, seven bits per byte with the high bit marking that more bytes
+ * follow, so most gaps of a sparse matrix take one or two bytes instead of
+ * four. Rows and columns are both kept, so either can be traversed.
+ */
+class CompressedPattern {
+private:
+	typedef std::vector<uint8_t> Bytes;
+
+	unsigned rows;
+	unsigned cols;
+	unsigned nonZeros;
+	Bytes rowBytes, colBytes;
+	std::vector<unsigned> rowStart, colStart;  // Offset of each line, + end
+
+	static void encode(const std::vector<unsigned>& indices,
+					   const std::vector<unsigned>& start, Bytes& bytes,
+					   std::vector<unsigned>& offsets);
+
+public:
+	CompressedPattern(const Matrix& matrix);
+
+	// Nonzero indices of one row or column, ascending; same interface as
+	// SpVec::InnerIterator without values
+	class Iterator {
+	private:
+		const uint8_t* pos;
+		const uint8_t* end;
+		unsigned ind;
+		bool valid;
+
+		void next() {
+			if (pos == end) {
+				valid = false;
+				return;
+			}
+			unsigned gap = *pos++;
+			if (gap & 0x80) {  // Gaps of 128 or more are the rare case
+				gap &= 0x7f;
+				unsigned shift = 7;
+				uint8_t byte;
+				do {
+					byte = *pos++;
+					gap |= (unsigned)(byte & 0x7f) << shift;
+					shift += 7;
+				} while (byte & 0x80);
+			}
+			ind += gap;
+		}
+
+	public:
+		Iterator(const uint8_t* begin, const uint8_t* end_)
+			: pos(begin), end(end_), ind(0), valid(true) {
+			next();
+		}
+		Iterator& operator++() {
+			next();
+			return *this;
+		}
+		explicit operator bool() const {
+			return valid;
+		}
+		unsigned index() const {
+			return ind;
+		}
+	};
+
+	inline unsigned getRows() const {
+		return rows;
+	}
+	inline unsigned getCols() const {
+		return cols;
+	}
+	inline unsigned getNonZeros() const {
+		return nonZeros;
+	}
+	Iterator row(unsigned r) const;
+	Iterator col(unsigned c) const;
+
+	// Pattern-only probes: nonzero indices with placeholder values of 1
+	void probeRow(unsigned r, SpVec& out) const;
+	void probeCol(unsigned c, SpVec& out) const;
+
+	// Size in memory, against the same two patterns as Eigen index arrays
+	size_t getBytes() const;
+	size_t getUncompressedBytes() const;
+};
+
+// Matrix oracle exploring through a compressed copy of its pattern. It owns
+// the pattern, the values column by column and b, so the matrix it was
+// built from need not outlive it. Rows with values are found by decoding
+// each of their columns, so getRow and probeRow are the slow path;
+// exploration and local problems only walk columns
+class CompressedOracle final : public Oracle {
+private:
+	CompressedPattern pattern;
+	std::vector<double> values;      // In column pattern order
+	std::vector<unsigned> colFirst;  // First value of each column, + end
+	DVec b;
+
+public:
+	CompressedOracle(const Matrix& m);
+
+	unsigned getRows() const override {
+		return pattern.getRows();
+	}
+	unsigned getCols() const override {
+		return pattern.getCols();
+	}
+	SpVec getRow(unsigned r) const override {
+		SpVec out;
+		probeRow(r, out);
+		return out;
+	}
+	SpVec getCol(unsigned c) const override {
+		SpVec out;
+		probeCol(c, out);
+		return out;
+	}
+	double getB(unsigned r) const override {
+		return b(r);
+	}
+	void probeRow(unsigned r, SpVec& out) const override;
+	void probeCol(unsigned c, SpVec& out) const override;
+	const CompressedPattern& getPattern() const {
+		return pattern;
+	}
+	// Local problem on rows_ x cols_, gathered from the owned columns
+	Matrix getSubmatrix(const uivector& rows_, const uivector& cols_) const;
+	// Everything held: pattern, values, column offsets and b
+	size_t getBytes() const;
+};
+
+inline void probeRowPattern(const CompressedOracle& oracle, unsigned r,
+							SpVec& out) {
+	oracle.getPattern().probeRow(r, out);
+}
+
+inline void probeColPattern(const CompressedOracle& oracle, unsigned c,
+							SpVec& out) {
+	oracle.getPattern().probeCol(c, out);
+}
+
+// viewSubmatrix() extracts the local problem through this, like any
+// backend that is not a stored Matrix
+inline Matrix extractSubmatrix(const CompressedOracle& oracle,
+							   const uivector& rows_, const uivector& cols_) {
+	return oracle.getSubmatrix(rows_, cols_);
+}
+
+#endif  // PATTERN_HPP
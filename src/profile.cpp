@@ -0,0 +1,144 @@
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "profile.hpp"
+
+const char* PHASE_NAMES[NUM_PHASES] = { "maxRank",  "bfs", "submatrix",
+										"restrict", "alg", "query" };
+const char* METRIC_NAMES[NUM_METRICS] = { "nodes", "edges", "depth", "rows",
+										  "cols" };
+
+void Histogram::add(uint64_t value) {
+	unsigned b = 0;
+	for (uint64_t v = value; v > 0; v >>= 1) {
+		++b;
+	}
+	++buckets[b];
+	++count;
+	sum += value;
+	max = std::max(max, value);
+}
+
+void Histogram::merge(const Histogram& other) {
+	for (unsigned b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+		buckets[b] += other.buckets[b];
+	}
+	count += other.count;
+	sum += other.sum;
+	max = std::max(max, other.max);
+}
+
+void Histogram::reset() {
+	std::fill(buckets, buckets + HISTOGRAM_BUCKETS, 0);
+	count = 0;
+	sum = 0;
+	max = 0;
+}
+
+void Histogram::writeJson(std::ostream& out) const {
+	// Only occupied buckets, as [lower bound, count] pairs
+	out << "{\"count\": " << count << ", \"sum\": " << sum
+		<< ", \"max\": " << max << ", \"buckets\": [";
+	bool first = true;
+	for (unsigned b = 0; b < HISTOGRAM_BUCKETS; ++b) {
+		if (buckets[b] == 0) {
+			continue;
+		}
+		uint64_t lower = b == 0 ? 0 : (uint64_t)1 << (b - 1);
+		out << (first ? "" : ", ") << "[" << lower << ", " << buckets[b]
+			<< "]";
+		first = false;
+	}
+	out << "]}";
+}
+
+void mergeProfile(Profile& into, const Profile& from) {
+	for (unsigned p = 0; p < NUM_PHASES; ++p) {
+		into.phases[p].merge(from.phases[p]);
+	}
+	for (unsigned m = 0; m < NUM_METRICS; ++m) {
+		into.metrics[m].merge(from.metrics[m]);
+	}
+	for (unsigned p = 0; p < NUM_PHASES; ++p) {
+		for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+			into.counters[p][c].merge(from.counters[p][c]);
+		}
+	}
+}
+
+// Profiles of threads that have exited
+std::mutex exitedLock;
+Profile exited;
+
+// Thread's profile, handed over to the exited total when the thread ends
+class ThreadProfile {
+public:
+	Profile profile;
+
+	~ThreadProfile() {
+		std::lock_guard<std::mutex> guard(exitedLock);
+		mergeProfile(exited, profile);
+	}
+};
+
+Profile& threadProfile() {
+	static thread_local ThreadProfile local;
+	return local.profile;
+}
+
+Profile collectProfile() {
+	std::lock_guard<std::mutex> guard(exitedLock);
+	Profile total = exited;
+	mergeProfile(total, threadProfile());
+	return total;
+}
+
+void resetProfile() {
+	std::lock_guard<std::mutex> guard(exitedLock);
+	exited = Profile();
+	threadProfile() = Profile();
+}
+
+std::atomic<bool> countersEnabled(false);
+
+void setProfileCounters(bool enable) {
+	countersEnabled = enable;
+}
+
+HardwareCounters* threadCounters() {
+	// Opened on a thread's first query after counters are enabled
+	static thread_local std::unique_ptr<HardwareCounters> counters;
+	if (!countersEnabled) {
+		return nullptr;
+	}
+	if (!counters) {
+		counters.reset(new HardwareCounters());
+	}
+	return counters->isAvailable() ? counters.get() : nullptr;
+}
+
+void writeProfileJson(std::ostream& out, const Profile& profile) {
+	out << "{\n  \"enabled\": " << (profileEnabled() ? "true" : "false")
+		<< ",\n  \"unit\": \"cycles\",\n  \"phases\": {";
+	for (unsigned p = 0; p < NUM_PHASES; ++p) {
+		out << (p ? "," : "") << "\n    \"" << PHASE_NAMES[p] << "\": ";
+		profile.phases[p].writeJson(out);
+	}
+	out << "\n  },\n  \"metrics\": {";
+	for (unsigned m = 0; m < NUM_METRICS; ++m) {
+		out << (m ? "," : "") << "\n    \"" << METRIC_NAMES[m] << "\": ";
+		profile.metrics[m].writeJson(out);
+	}
+	out << "\n  },\n  \"counters\": {";
+	for (unsigned p = 0; p < NUM_PHASES; ++p) {
+		out << (p ? "," : "") << "\n    \"" << PHASE_NAMES[p] << "\": {";
+		for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+			out << (c ? "," : "") << "\n      \"" << counterName((Counter)c)
+				<< "\": ";
+			profile.counters[p][c].writeJson(out);
+		}
+		out << "\n    }";
+	}
+	out << "\n  }\n}" << std::endl;
+}
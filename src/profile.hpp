@@ -0,0 +1,198 @@
+#ifndef PROFILE_HPP
+#define PROFILE_HPP
+
+// Includes
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include "counters.hpp"
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+/**
+ * Per-phase instrumentation of loco()
+ * Build with LOCO_PROFILE defined to record, for every query, the cycles
+ * spent in each phase and the shape of its exploration. Records go to a
+ * per-thread Profile; a thread's profile is merged into the process total
+ * when the thread exits, so solve() workers need no locking while running.
+ * With setProfileCounters(true), each phase also records hardware counter
+ * deltas (see counters.hpp), at the cost of a few system calls per phase.
+ * Without LOCO_PROFILE, QueryProfile is empty and its calls compile away.
+ */
+
+// Timed phases of one query
+enum Phase {
+	PHASE_MAXRANK,    // Root selection
+	PHASE_BFS,        // Exploration of X_k and Y_k
+	PHASE_SUBMATRIX,  // Gathering the local problem
+	PHASE_RESTRICT,   // restrictFunctions
+	PHASE_ALG,        // Online algorithm
+	PHASE_QUERY,      // Whole query
+	NUM_PHASES
+};
+
+// Counted quantities of one query
+enum Metric {
+	METRIC_NODES,  // Variables reached, |X_k| + |Y_k|
+	METRIC_EDGES,  // Nonzeros traversed (messages)
+	METRIC_DEPTH,  // BFS levels
+	METRIC_ROWS,   // Rows of the local problem
+	METRIC_COLS,   // Columns of the local problem
+	NUM_METRICS
+};
+
+const unsigned HISTOGRAM_BUCKETS = 65;  // Zero, then one per power of two
+
+// Cycle counter where the CPU has one, nanoseconds elsewhere
+inline uint64_t readCycles() {
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) || \
+	defined(__x86_64__) || defined(__i386__)
+	return __rdtsc();
+#else
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+			   std::chrono::steady_clock::now().time_since_epoch())
+		.count();
+#endif
+}
+
+// Log2-bucketed histogram: bucket b > 0 holds values in [2^(b-1), 2^b)
+class Histogram {
+private:
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+	uint64_t count;
+	uint64_t sum;
+	uint64_t max;
+
+public:
+	Histogram() {
+		reset();
+	}
+
+	void add(uint64_t value);
+	void merge(const Histogram& other);
+	void reset();
+	void writeJson(std::ostream& out) const;
+
+	uint64_t getCount() const {
+		return count;
+	}
+	uint64_t getSum() const {
+		return sum;
+	}
+	uint64_t getMax() const {
+		return max;
+	}
+	uint64_t getBucket(unsigned b) const {
+		return buckets[b];
+	}
+};
+
+typedef struct {
+	Histogram phases[NUM_PHASES];
+	Histogram metrics[NUM_METRICS];
+	Histogram counters[NUM_PHASES][NUM_COUNTERS];  // Empty unless enabled
+} Profile;
+
+// Profile of queries run on the calling thread
+Profile& threadProfile();
+// Queries of all exited threads plus the calling thread
+Profile collectProfile();
+void resetProfile();
+// Whether queries also read hardware counters, and the calling thread's
+// counters if so (nullptr when disabled)
+void setProfileCounters(bool enable);
+HardwareCounters* threadCounters();
+void writeProfileJson(std::ostream& out, const Profile& profile);
+inline bool profileEnabled() {
+#ifdef LOCO_PROFILE
+	return true;
+#else
+	return false;
+#endif
+}
+
+#ifdef LOCO_PROFILE
+// Records one query into the thread's profile
+class QueryProfile {
+private:
+	Profile& profile;
+	HardwareCounters* counters;
+	uint64_t start;
+	uint64_t last;
+	uint64_t startCounts[NUM_COUNTERS];
+	uint64_t lastCounts[NUM_COUNTERS];
+	unsigned depth;
+	unsigned levelEnd;
+
+	void addCounts(Phase p, const uint64_t from[NUM_COUNTERS],
+				   const uint64_t to[NUM_COUNTERS]) {
+		for (unsigned c = 0; c < NUM_COUNTERS; ++c) {
+			// Multiplexed counts are estimates and may step back slightly
+			profile.counters[p][c].add(to[c] > from[c] ? to[c] - from[c] : 0);
+		}
+	}
+
+public:
+	QueryProfile()
+		: profile(threadProfile()),
+		  counters(threadCounters()),
+		  depth(0),
+		  levelEnd(0) {
+		if (counters != nullptr) {
+			counters->read(startCounts);
+			std::copy(startCounts, startCounts + NUM_COUNTERS, lastCounts);
+		}
+		start = last = readCycles();
+	}
+	~QueryProfile() {
+		profile.phases[PHASE_QUERY].add(readCycles() - start);
+		if (counters != nullptr) {
+			uint64_t now[NUM_COUNTERS];
+			counters->read(now);
+			addCounts(PHASE_QUERY, startCounts, now);
+		}
+	}
+
+	// Charge the time since the previous phase ended to phase
+	void phase(Phase p) {
+		uint64_t now = readCycles();
+		profile.phases[p].add(now - last);
+		if (counters != nullptr) {
+			uint64_t counts[NUM_COUNTERS];
+			counters->read(counts);
+			addCounts(p, lastCounts, counts);
+			std::copy(counts, counts + NUM_COUNTERS, lastCounts);
+		}
+		last = readCycles();  // Leave the counter reads out of the next phase
+	}
+	void record(Metric m, uint64_t value) {
+		profile.metrics[m].add(value);
+	}
+	// Called as BFS takes queue position curr of a queue currently end long
+	void visit(unsigned curr, unsigned end) {
+		if (curr >= levelEnd) {
+			++depth;
+			levelEnd = end;
+		}
+	}
+	unsigned getDepth() const {
+		return depth;
+	}
+};
+#else
+class QueryProfile {
+public:
+	void phase(Phase) {}
+	void record(Metric, uint64_t) {}
+	void visit(unsigned, unsigned) {}
+	unsigned getDepth() const {
+		return 0;
+	}
+};
+#endif
+
+#endif  // PROFILE_HPP
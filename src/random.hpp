@@ -0,0 +1,125 @@
+#ifndef RANDOM_HPP
+#define RANDOM_HPP
+
+// Includes
+#include <chrono>
+#include <cstdint>
+
+// Counter-based randomness: every value is a pure function of a seed and
+// the indices it belongs to, so it can be regenerated on demand, in any
+// order and on any thread.
+
+// SplitMix64 finalizer, a fast bijective 64-bit mixer
+inline uint64_t mix64(uint64_t z) {
+	z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+	z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+	return z ^ (z >> 31);
+}
+
+// Hash a seed and up to three counters into 64 random bits
+inline uint64_t hashKey(uint64_t seed, uint64_t a, uint64_t b = 0,
+						uint64_t c = 0) {
+	const uint64_t GOLDEN = 0x9e3779b97f4a7c15ULL;
+	uint64_t h = mix64(seed + GOLDEN);
+	h = mix64(h ^ (a + GOLDEN));
+	h = mix64(h ^ (b + 2 * GOLDEN));
+	return mix64(h ^ (c + 3 * GOLDEN));
+}
+
+// Map 64 random bits to a real number in [0, 1)
+inline double toUniform(uint64_t h) {
+	return (h >> 11) * (1.0 / 9007199254740992.0);
+}
+
+const uint64_t TAG_RANK = 0x52414e4b;  // "RANK", stream of variable ranks
+
+// Seed for runs that do not ask to be reproducible
+inline uint64_t clockSeed() {
+	return (uint64_t)std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+// Sequential draws from stream tag of a seed: draw i is hashKey(seed, tag,
+// i), so streams are independent and any draw can be recomputed directly.
+// Usable as a standard uniform random bit generator.
+class RandomStream {
+private:
+	uint64_t seed;
+	uint64_t tag;
+	uint64_t counter;
+
+public:
+	typedef uint64_t result_type;
+
+	RandomStream(uint64_t seed_, uint64_t tag_, uint64_t start = 0)
+		: seed(seed_), tag(tag_), counter(start) {}
+
+	static constexpr uint64_t min() {
+		return 0;
+	}
+	static constexpr uint64_t max() {
+		return ~0ULL;
+	}
+	uint64_t operator()() {
+		return hashKey(seed, tag, counter++);
+	}
+	double uniform() {
+		return toUniform((*this)());
+	}
+};
+
+// Pseudo-random bijection on [0, n) that never materializes a table:
+// balanced Feistel network on the smallest even bit width covering n,
+// cycle-walking back into range
+class Permutation {
+private:
+	static const unsigned ROUNDS = 4;
+	uint64_t n;
+	uint64_t seed;
+	unsigned half;  // Bits in each Feistel half
+	uint64_t mask;
+
+	uint64_t round(unsigned i, uint64_t x) const {
+		return hashKey(seed, i, x) & mask;
+	}
+	uint64_t encrypt(uint64_t x) const {
+		uint64_t l = x >> half, r = x & mask;
+		for (unsigned i = 0; i < ROUNDS; ++i) {
+			uint64_t t = l ^ round(i, r);
+			l = r;
+			r = t;
+		}
+		return (l << half) | r;
+	}
+	uint64_t decrypt(uint64_t x) const {
+		uint64_t l = x >> half, r = x & mask;
+		for (unsigned i = ROUNDS; i-- > 0;) {
+			uint64_t t = r ^ round(i, l);
+			r = l;
+			l = t;
+		}
+		return (l << half) | r;
+	}
+
+public:
+	Permutation(uint64_t n_, uint64_t seed_) : n(n_), seed(seed_), half(1) {
+		while ((1ULL << (2 * half)) < n) {
+			++half;
+		}
+		mask = (1ULL << half) - 1;
+	}
+
+	uint64_t operator()(uint64_t x) const {
+		do {
+			x = encrypt(x);
+		} while (x >= n);
+		return x;
+	}
+	uint64_t inverse(uint64_t y) const {
+		do {
+			y = decrypt(y);
+		} while (y >= n);
+		return y;
+	}
+};
+
+#endif  // RANDOM_HPP
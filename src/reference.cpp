@@ -0,0 +1,298 @@
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <thread>
+#include "build.hpp"
+#include "reference.hpp"
+
+const unsigned CHECK_EVERY = 10;     // Iterations between bound checks
+const double MAX_PRIMAL = 1e12;      // Beyond this a 1-D search gives up
+const double SEARCH_PRECISION = 1e-10;
+
+// Reusable rendezvous of a fixed number of threads
+class Barrier {
+private:
+	std::mutex lock;
+	std::condition_variable released;
+	unsigned count;
+	unsigned waiting;
+	uint64_t generation;
+
+public:
+	Barrier(unsigned n) : count(n), waiting(0), generation(0) {}
+
+	void wait() {
+		std::unique_lock<std::mutex> guard(lock);
+		uint64_t arrived = generation;
+		if (++waiting == count) {
+			waiting = 0;
+			++generation;
+			released.notify_all();
+		} else {
+			released.wait(guard, [&]() { return generation != arrived; });
+		}
+	}
+};
+
+// Forward difference, fine enough for a reference answer; like the online
+// algorithm, only evaluates f on x >= 0
+static double slope(const fun& f, double x) {
+	double h = 1e-7 * (1 + x);
+	return (f(x + h) - f(x)) / h;
+}
+
+// Least x >= 0 with g(x) >= 0 for nondecreasing g, searched outward from
+// guess; -1 when g stays negative up to MAX_PRIMAL
+template <typename G>
+static double solveIncreasing(G g, double guess) {
+	if (g(0) >= 0) {
+		return 0;
+	}
+	double lo = 0, hi = std::max(guess, 1e-9);
+	if (g(hi) < 0) {
+		do {
+			lo = hi;
+			hi *= 2;
+			if (hi > MAX_PRIMAL) {
+				return -1;
+			}
+		} while (g(hi) < 0);
+	} else {
+		for (double down = hi / 2; down > 1e-12; down /= 2) {
+			if (g(down) < 0) {
+				lo = down;
+				break;
+			}
+			hi = down;
+		}
+	}
+	while (hi - lo > SEARCH_PRECISION * hi) {
+		double mid = (lo + hi) / 2;
+		(g(mid) >= 0 ? hi : lo) = mid;
+	}
+	return hi;
+}
+
+// argmin over x >= 0 of f(x) + (x - v)^2 / (2 tau)
+static double prox(const fun& f, double v, double tau, double guess) {
+	double x = solveIncreasing(
+		[&](double z) { return slope(f, z) + (z - v) / tau; }, guess);
+	return std::max(x, 0.0);
+}
+
+// inf over x >= 0 of f(x) - a x, and where it is reached; false if the
+// infimum is not reached below MAX_PRIMAL, taken as unbounded
+static bool minimizeShifted(const fun& f, double a, double& value,
+							double& at) {
+	at = solveIncreasing([&](double z) { return slope(f, z) - a; }, 1);
+	if (at < 0) {
+		return false;
+	}
+	value = f(at) - a * at;
+	return true;
+}
+
+ReferenceSolution solveReference(const Matrix& matrix, const fvector& funs,
+								 ReferenceSettings settings) {
+	unsigned m = matrix.getRows();
+	unsigned n = matrix.getCols();
+	if (funs.size() != n) {
+		std::cout << "solveReference ERROR: funs, cols size mismatch!\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::vector<T> triplets = matrix.getTriplets();
+	for (const T& t : triplets) {
+		if (t.value() < 0) {
+			std::cout << "solveReference ERROR: covering needs A >= 0\n"
+				<< std::endl;
+			exit(EXIT_FAILURE);
+		}
+	}
+	SpMat csc;
+	SpMatR csr;
+	buildSparse(m, n, triplets, csc, &csr, DUPLICATES_SUM, settings.threads);
+	std::vector<T>().swap(triplets);
+
+	unsigned threads = settings.threads;
+	if (threads == 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::max(1u, std::min(threads, std::min(m, n)));
+
+	// Diagonal preconditioning: steps of one over each row and column sum
+	// converge without estimating the norm of A (Pock and Chambolle, 2011)
+	dvector sigma(m, 0), tau(n, 0);
+	ReferenceSolution s;
+	s.uncovered = 0;
+	for (unsigned i = 0; i < m; ++i) {
+		double sum = 0;
+		for (SpMatR::InnerIterator it(csr, i); it; ++it) {
+			sum += it.value();
+		}
+		sigma[i] = sum > 0 ? 1 / sum : 0;  // Rows left out keep u_i = 0
+		s.uncovered += sum <= 0;
+	}
+	dvector x(n, 0), xBar(n, 0), a(n, 0), u(m, 0);
+	for (unsigned j = 0; j < n; ++j) {
+		double sum = 0;
+		for (SpMat::InnerIterator it(csc, j); it; ++it) {
+			sum += it.value();
+		}
+		double value;
+		if (sum > 0) {
+			tau[j] = 1 / sum;
+		} else if (minimizeShifted(funs[j], 0, value, x[j])) {
+			xBar[j] = x[j];  // Constrains nothing: cheapest point, fixed
+		}
+	}
+
+	s.objective = std::numeric_limits<double>::infinity();
+	s.lowerBound = -std::numeric_limits<double>::infinity();
+	s.iterations = 0;
+	s.primals = dvector(n, 0);
+
+	// Per-thread partial results of a bound check, combined by thread 0
+	std::vector<double> minCover(threads), sumU(threads), objective(threads),
+		dual(threads);
+	double scale = 0;
+	bool stop = false;
+	Barrier barrier(threads);
+	auto worker = [&](unsigned t) {
+		unsigned rowBegin = (unsigned)((uint64_t)m * t / threads);
+		unsigned rowEnd = (unsigned)((uint64_t)m * (t + 1) / threads);
+		unsigned colBegin = (unsigned)((uint64_t)n * t / threads);
+		unsigned colEnd = (unsigned)((uint64_t)n * (t + 1) / threads);
+		for (unsigned iter = 0; iter < settings.iterations && !stop; ++iter) {
+			// 1. Dual ascent on every row, from the extrapolated primals
+			for (unsigned i = rowBegin; i < rowEnd; ++i) {
+				double cover = 0;
+				for (SpMatR::InnerIterator it(csr, i); it; ++it) {
+					cover += it.value() * xBar[it.col()];
+				}
+				u[i] = std::max(0.0, u[i] + sigma[i] * (1 - cover));
+			}
+			barrier.wait();
+
+			// 2. Proximal step on every column, then extrapolate
+			for (unsigned j = colBegin; j < colEnd; ++j) {
+				if (tau[j] == 0) {
+					continue;
+				}
+				a[j] = 0;  // Column j times u
+				for (SpMat::InnerIterator it(csc, j); it; ++it) {
+					a[j] += it.value() * u[it.row()];
+				}
+				double next = prox(funs[j], x[j] + tau[j] * a[j], tau[j], x[j]);
+				xBar[j] = 2 * next - x[j];
+				x[j] = next;
+			}
+			barrier.wait();
+
+			if (iter % CHECK_EVERY != CHECK_EVERY - 1 &&
+				iter + 1 != settings.iterations) {
+				continue;
+			}
+
+			// 3. Scale x to cover every row for an upper bound, and
+			//    evaluate the Lagrangian of u for a lower bound
+			double least = std::numeric_limits<double>::infinity(), sum = 0;
+			for (unsigned i = rowBegin; i < rowEnd; ++i) {
+				if (sigma[i] == 0) {
+					continue;
+				}
+				double cover = 0;
+				for (SpMatR::InnerIterator it(csr, i); it; ++it) {
+					cover += it.value() * x[it.col()];
+				}
+				least = std::min(least, cover);
+				sum += u[i];
+			}
+			minCover[t] = least;
+			sumU[t] = sum;
+			barrier.wait();
+			if (t == 0) {
+				least = *std::min_element(minCover.begin(), minCover.end());
+				// No row to cover leaves x as it is; a row still at zero
+				// cover gives no bound this time
+				scale = least == std::numeric_limits<double>::infinity() ? 1
+					: least > 0 ? 1 / least : 0;
+			}
+			barrier.wait();
+
+			double cost = 0, lagrangian = 0;
+			for (unsigned j = colBegin; j < colEnd; ++j) {
+				cost += funs[j](tau[j] > 0 ? scale * x[j] : x[j]);
+				double value, at;
+				if (!minimizeShifted(funs[j], a[j], value, at)) {
+					value = -std::numeric_limits<double>::infinity();
+				}
+				lagrangian += value;
+			}
+			objective[t] = cost;
+			dual[t] = lagrangian;
+			barrier.wait();
+			if (t == 0) {
+				s.iterations = iter + 1;
+				double upper = 0, lower = 0;
+				for (unsigned w = 0; w < threads; ++w) {
+					upper += objective[w];
+					lower += dual[w] + sumU[w];
+				}
+				if (scale > 0 && upper < s.objective) {
+					s.objective = upper;
+					for (unsigned j = 0; j < n; ++j) {
+						s.primals[j] = tau[j] > 0 ? scale * x[j] : x[j];
+					}
+				}
+				s.lowerBound = std::max(s.lowerBound, lower);
+				stop = s.objective - s.lowerBound <=
+					settings.tolerance * std::abs(s.objective);
+			}
+			barrier.wait();
+		}
+	};
+
+	std::vector<std::thread> pool;
+	for (unsigned t = 1; t < threads; ++t) {
+		pool.push_back(std::thread(worker, t));
+	}
+	worker(0);
+	for (std::thread& t : pool) {
+		t.join();
+	}
+	return s;
+}
+
+CoverQuality evaluateCover(const Matrix& matrix, const fvector& funs,
+						   const dvector& primals) {
+	unsigned m = matrix.getRows();
+	unsigned n = matrix.getCols();
+	if (funs.size() != n || primals.size() != n) {
+		std::cout << "evaluateCover ERROR: funs, primals, cols size "
+			<< "mismatch!\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	CoverQuality q;
+	q.objective = 0;
+	dvector cover(m, 0);
+	std::vector<bool> coverable(m, false);
+	SpVec col;
+	for (unsigned j = 0; j < n; ++j) {
+		q.objective += funs[j](primals[j]);
+		matrix.probeCol(j, col);
+		for (SpVec::InnerIterator it(col); it; ++it) {
+			cover[it.index()] += it.value() * primals[j];
+			coverable[it.index()] = coverable[it.index()] || it.value() > 0;
+		}
+	}
+	q.minCover = std::numeric_limits<double>::infinity();
+	q.violated = 0;
+	for (unsigned i = 0; i < m; ++i) {
+		if (coverable[i]) {
+			q.minCover = std::min(q.minCover, cover[i]);
+			q.violated += cover[i] < 1 - 1e-9;
+		}
+	}
+	return q;
+}
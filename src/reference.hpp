@@ -0,0 +1,52 @@
+#ifndef REFERENCE_HPP
+#define REFERENCE_HPP
+
+// Includes
+#include "loco.hpp"
+
+/**
+ * Offline reference solver for the covering program
+ *
+ *      min sum_j f_j(x_j)  s.t.  Ax >= 1, x >= 0
+ *
+ * with A >= 0 and every f_j convex, for judging LOCO's answers against a
+ * global solve. Runs diagonally preconditioned primal-dual hybrid gradient
+ * iterations (Chambolle-Pock): a dual step on every row, then a proximal
+ * step on every column, each split over threads by rows of a CSR copy and
+ * columns of a CSC copy of A. Every few iterations the iterate is scaled
+ * up until it covers every row, giving a feasible upper bound, and the
+ * Lagrangian of the duals gives a lower bound; the solver stops once they
+ * are within tolerance of each other. Rows without a positive entry
+ * cannot be covered and are left out.
+ */
+
+typedef struct {
+	unsigned iterations;  // Most primal-dual iterations
+	double tolerance;     // Relative gap between the bounds to stop at
+	unsigned threads;     // 0: every core
+} ReferenceSettings;
+const ReferenceSettings DEFAULT_REFERENCE = { 20000, 1e-4, 0 };
+
+typedef struct {
+	dvector primals;     // Best feasible point found
+	double objective;    // Its sum_j f_j(x_j), an upper bound on the optimum
+	double lowerBound;   // Best dual bound (-infinity if none was finite)
+	unsigned iterations;
+	unsigned uncovered;  // Rows left out: no positive entry
+} ReferenceSolution;
+
+ReferenceSolution solveReference(
+	const Matrix& matrix, const fvector& funs,
+	ReferenceSettings settings = DEFAULT_REFERENCE);
+
+// Objective and coverage of any primals, LOCO's included
+typedef struct {
+	double objective;   // sum_j f_j(x_j)
+	double minCover;    // Least (Ax)_i over rows that can be covered
+	unsigned violated;  // Rows that can be covered with (Ax)_i < 1 - 1e-9
+} CoverQuality;
+
+CoverQuality evaluateCover(const Matrix& matrix, const fvector& funs,
+						   const dvector& primals);
+
+#endif  // REFERENCE_HPP
@@ -0,0 +1,130 @@
+#include "service.hpp"
+
+QueryService::QueryService(online alg_, Matrix matrix, fvector funs,
+						   dvector ranks, unsigned budget_,
+						   size_t cacheCapacity)
+	: alg(alg_), budget(budget_) {
+	if (funs.size() < matrix.getCols()) {
+		std::cout << "QueryService ERROR: fewer functions than columns\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	if (ranks.size() != matrix.getRows()) {
+		ranks = generateRanks(matrix.getRows());
+	}
+	std::shared_ptr<const Snapshot> first(
+		new Snapshot(std::make_shared<Matrix>(std::move(matrix)),
+					 std::make_shared<fvector>(std::move(funs)),
+					 std::make_shared<dvector>(std::move(ranks)), 0, 0));
+	std::atomic_store(&current, first);
+	if (cacheCapacity > 0) {
+		cache.reset(new SolutionCache(cacheCapacity));
+	}
+}
+
+LocoSolution QueryService::query(unsigned ind,
+								 unsigned long long* epoch) const {
+	// Stamp first: a state read after it can only be replaced by an update
+	// whose invalidation also rejects the insert below
+	unsigned long long stamp = cache ? cache->getStamp() : 0;
+
+	// Holding the snapshot keeps it alive even if a writer replaces it
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	if (epoch != nullptr) {
+		*epoch = s->epoch;
+	}
+	if (!cache) {
+		return loco(alg, *s->matrix, *s->funs, *s->ranks, ind, budget);
+	}
+
+	LocoSolution solution;
+	if (cache->lookup(ind, s->rankEpoch, solution)) {
+		return solution;
+	}
+	Footprint footprint;
+	FootprintRecorder<Matrix> recorder(*s->matrix, footprint);
+	solution = loco(alg, recorder, *s->funs, *s->ranks, ind, budget);
+	cache->insert(ind, s->rankEpoch, solution, std::move(footprint), stamp);
+	return solution;
+}
+
+unsigned long long QueryService::publish(std::shared_ptr<const Matrix> m,
+										 std::shared_ptr<const fvector> f,
+										 std::shared_ptr<const dvector> r,
+										 bool newRanks) {
+	// Caller holds writers, so the epochs cannot change underneath
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	unsigned long long epoch = s->epoch + 1;
+	unsigned long long rankEpoch = s->rankEpoch + (newRanks ? 1 : 0);
+	std::atomic_store(&current, std::shared_ptr<const Snapshot>(new Snapshot(
+									std::move(m), std::move(f), std::move(r),
+									epoch, rankEpoch)));
+	return epoch;
+}
+
+unsigned long long QueryService::updateCells(const std::vector<T>& cells) {
+	std::lock_guard<std::mutex> guard(writers);
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	std::shared_ptr<Matrix> next = std::make_shared<Matrix>(*s->matrix);
+	next->setCells(cells);
+	unsigned long long epoch = publish(std::move(next), s->funs, s->ranks);
+	if (cache) {
+		// A cell changes both its row and its column
+		uivector rows, cols;
+		for (const T& t : cells) {
+			rows.push_back((unsigned)t.row());
+			cols.push_back((unsigned)t.col());
+		}
+		cache->invalidate(rows, cols, uivector());
+	}
+	return epoch;
+}
+
+unsigned long long QueryService::updateFunctions(const fvector& funs) {
+	std::lock_guard<std::mutex> guard(writers);
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	if (funs.size() < s->matrix->getCols()) {
+		std::cout << "updateFunctions ERROR: fewer functions than columns\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	unsigned long long epoch =
+		publish(s->matrix, std::make_shared<fvector>(funs), s->ranks);
+	if (cache) {
+		cache->clear();
+	}
+	return epoch;
+}
+
+unsigned long long QueryService::updateFunction(unsigned j, const fun& f) {
+	std::lock_guard<std::mutex> guard(writers);
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	if (j >= s->funs->size()) {
+		std::cout << "updateFunction ERROR: j exceeds funs vector\n"
+			<< std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::shared_ptr<fvector> funs = std::make_shared<fvector>(*s->funs);
+	(*funs)[j] = f;
+	unsigned long long epoch = publish(s->matrix, std::move(funs), s->ranks);
+	if (cache) {
+		cache->invalidate(uivector(), uivector(), uivector(1, j));
+	}
+	return epoch;
+}
+
+unsigned long long QueryService::updateRanks(const dvector& ranks) {
+	std::lock_guard<std::mutex> guard(writers);
+	std::shared_ptr<const Snapshot> s = getSnapshot();
+	if (ranks.size() != s->matrix->getRows()) {
+		std::cout << "updateRanks ERROR: ranks and matrix rows different "
+			"sizes\n" << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	unsigned long long epoch = publish(
+		s->matrix, s->funs, std::make_shared<dvector>(ranks), true);
+	if (cache) {
+		cache->clear();  // Entries of the old rank epoch can never hit again
+	}
+	return epoch;
+}
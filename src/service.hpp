@@ -0,0 +1,81 @@
+#ifndef SERVICE_HPP
+#define SERVICE_HPP
+
+// Includes
+#include <memory>
+#include <mutex>
+#include "cache.hpp"
+
+// Immutable problem state that queries run against; the parts an update
+// leaves alone are shared with the snapshot before it
+class Snapshot {
+public:
+	const std::shared_ptr<const Matrix> matrix;
+	const std::shared_ptr<const fvector> funs;
+	const std::shared_ptr<const dvector> ranks;
+	const unsigned long long epoch;      // Number of updates before this one
+	const unsigned long long rankEpoch;  // Number of rank updates before it
+
+	Snapshot(std::shared_ptr<const Matrix> m, std::shared_ptr<const fvector> f,
+			 std::shared_ptr<const dvector> r, unsigned long long e,
+			 unsigned long long re)
+		: matrix(std::move(m)),
+		  funs(std::move(f)),
+		  ranks(std::move(r)),
+		  epoch(e),
+		  rankEpoch(re) {}
+};
+
+/**
+ * Resident solver answering loco() queries from any number of threads
+ * Queries run against the snapshot current when they start and never
+ * block. Writers build the next snapshot from a private copy and publish
+ * it with one atomic pointer swap (RCU-style); a snapshot is freed once
+ * the last query holding it returns. Writers are serialized, and each
+ * update costs a copy of the state it changes: the matrix, the functions
+ * and the ranks are held separately, and an update shares the ones it
+ * does not change with the previous snapshot.
+ *
+ * With a cache capacity, solutions are kept in a SolutionCache and each
+ * update invalidates only the entries whose footprint it touches. An
+ * update is published before its invalidation, so a query may briefly
+ * get the answer from just before the update, as if it had run earlier.
+ */
+class QueryService {
+private:
+	online alg;
+	unsigned budget;
+	std::shared_ptr<const Snapshot> current;  // Only through atomic_load/store
+	std::mutex writers;
+	std::unique_ptr<SolutionCache> cache;     // Null when caching is off
+
+	unsigned long long publish(std::shared_ptr<const Matrix> m,
+							   std::shared_ptr<const fvector> f,
+							   std::shared_ptr<const dvector> r,
+							   bool newRanks = false);
+
+public:
+	QueryService(online alg_, Matrix matrix, fvector funs, dvector ranks,
+				 unsigned budget_ = UNLIMITED, size_t cacheCapacity = 0);
+
+	std::shared_ptr<const Snapshot> getSnapshot() const {
+		return std::atomic_load(&current);
+	}
+	unsigned long long getEpoch() const {
+		return getSnapshot()->epoch;
+	}
+	// Solve for x_ind, optionally reporting the epoch answered from
+	LocoSolution query(unsigned ind, unsigned long long* epoch = nullptr) const;
+
+	// Publish a new snapshot and return its epoch
+	unsigned long long updateCells(const std::vector<T>& cells);
+	unsigned long long updateFunctions(const fvector& funs);
+	unsigned long long updateFunction(unsigned j, const fun& f);
+	unsigned long long updateRanks(const dvector& ranks);
+
+	const SolutionCache* getCache() const {
+		return cache.get();
+	}
+};
+
+#endif  // SERVICE_HPP
@@ -1,26 +1,46 @@
+#include <sstream>
+#include "async.hpp"
+#include "distributed.hpp"
+#include "implicit.hpp"
+#include "pattern.hpp"
+#include "reference.hpp"
+#include "service.hpp"
+#include "trace.hpp"
 #include "loco.hpp"
 
-int main() {
-	// Create uniform random real number generator for range [0, 1)
-	unsigned seed =
-		(unsigned)std::chrono::system_clock::now().time_since_epoch().count();
-	std::default_random_engine gen(seed);
-	std::uniform_real_distribution<double> dist(0, 1);
+const uint64_t TAG_COSTS = 8;  // Random stream of cost coefficients
+
+// Writes the sum of the local problem's b as its only primal, so the b a
+// scenario hands to the online algorithm can be checked
+static void sumB(const MatrixView& matrix, const fvector&, double,
+				 Eigen::Ref<DVec> x) {
+	x.setZero();
+	for (unsigned i = 0; i < matrix.getRows(); ++i) {
+		x(0) += matrix.getB(i);
+	}
+}
+
+int main(int argc, char* argv[]) {
+	// Same seed, same run: pass one to reproduce a previous run
+	uint64_t seed = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : clockSeed();
+	std::cout << "Seed: " << seed << std::endl;
+	RandomStream costs(seed, TAG_COSTS);
 
 	// Create matrix and set function pointer to online algorithm
-	Matrix matrix;
+	Matrix matrix = Matrix::seeded(DEFAULT_SIZE, DEFAULT_SIZE, seed);
 	online alg = onlineFractional;
 
 	// Generate vector of functions, such that f(x_i) = c x_i^2, 0 <= c < 1
 	unsigned count = matrix.getCols();
 	fvector funs;
 	for (unsigned i = 0; i < count; ++i) {
-		double c = dist(gen);
+		double c = costs.uniform();
 		std::function<double(double)> fun = [c](double x) { return c * x * x; };
 		funs.push_back(fun);
 	}
 
-	MatrixSolution s = solve(alg, matrix, funs);
+	dvector ranks = generateRanks(matrix.getRows(), seed);
+	MatrixSolution s = solve(alg, matrix, funs, ranks);
 
 	// std::cout << "Printing matrix...\n";
 	// matrix.printDense();
@@ -32,6 +52,406 @@ int main() {
 	std::cout << "]" << std::endl;
 
 	std::cout << "Messages: " << s.messages << std::endl;
+	std::cout << "Probes: " << s.probes << std::endl;
+
+	// Compare scheduler's cost estimates against messages actually sent
+	unsigned predicted = 0, worst = 0;
+	for (unsigned i = 0; i < count; ++i) {
+		predicted += s.predicted[i];
+		if (s.actual[i] > s.actual[worst]) {
+			worst = i;
+		}
+	}
+	std::cout << "Predicted messages: " << predicted << std::endl;
+	std::cout << "Most expensive query: x_" << worst << ", predicted "
+		<< s.predicted[worst] << ", actual " << s.actual[worst] << std::endl;
+
+	// Sketch estimates stay well within their error bound of every count,
+	// and a budget caps them
+	bool isGood = true;
+	unsigned cap = s.predicted[worst] / 2;
+	uivector bounded = estimateCosts(matrix, ranks, cap);
+	for (unsigned i = 0; i < count; ++i) {
+		isGood = isGood && s.predicted[i] <= 1.5 * s.actual[i] &&
+			s.actual[i] <= 1.5 * s.predicted[i] &&
+			bounded[i] == std::min(s.predicted[i], cap);
+	}
+	std::cout << "Testing cost estimates...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Cap every query at the median predicted cost and count fallbacks
+	uivector sorted = s.predicted;
+	std::sort(sorted.begin(), sorted.end());
+	unsigned budget = sorted[count / 2];
+	MatrixSolution capped = solve(alg, matrix, funs, ranks, 0, budget);
+	std::cout << "Budget " << budget << ": " << capped.truncated << " of "
+		<< count << " queries truncated, messages " << capped.messages
+		<< std::endl;
+
+	// One exploration per primal for several scenarios must give what
+	// solving each scenario separately gives
+	std::vector<Scenario> scenarios(3);
+	for (unsigned sc = 0; sc < scenarios.size(); ++sc) {
+		double scale = 1 + sc;
+		for (unsigned i = 0; i < count; ++i) {
+			fun f = funs[i];
+			scenarios[sc].funs.push_back(
+				[f, scale](double x) { return scale * f(x); });
+		}
+	}
+	scenarios[2].b = matrix.getB() * 2;
+	ScenarioSolution batch =
+		solveScenarios(alg, matrix, scenarios, ranks, 0, budget);
+	isGood = batch.messages == capped.messages &&
+		batch.truncated == capped.truncated;
+	for (unsigned sc = 0; sc < scenarios.size(); ++sc) {
+		MatrixSolution one =
+			solve(alg, matrix, scenarios[sc].funs, ranks, 0, budget);
+		for (unsigned i = 0; i < count; ++i) {
+			isGood = isGood && checkError(one.primals[i], batch.primals(sc, i));
+		}
+	}
+	std::cout << "Testing scenario batch...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// The local problem must read each scenario's own b
+	ScenarioSolution sums =
+		solveScenarios(sumB, matrix, scenarios, ranks, 0, budget);
+	bool nonZero = false;
+	isGood = true;
+	for (unsigned i = 0; i < count; ++i) {
+		isGood = isGood && sums.primals(1, i) == sums.primals(0, i) &&
+			sums.primals(2, i) == 2 * sums.primals(0, i);
+		nonZero = nonZero || sums.primals(0, i) != 0;
+	}
+	std::cout << "Testing scenario b...\t\t\t"
+		<< (isGood && nonZero ? "OK" : "FAILED") << std::endl;
+
+	// Each repetition must match solve() with its own ranks, and the
+	// combined primals must be taken from them
+	const unsigned REPETITIONS = 3;
+	RepeatedSolution repeated = solveRepeated(
+		alg, matrix, funs, REPETITIONS, seed, COMBINE_MEDIAN, 0, budget);
+	RepeatedSolution least = solveRepeated(alg, matrix, funs, REPETITIONS,
+										   seed, COMBINE_MIN, 0, budget);
+	isGood = repeated.repetitions == least.repetitions;
+	for (unsigned r = 0; r < REPETITIONS; ++r) {
+		dvector reps =
+			generateRanks(matrix.getRows(), repetitionSeed(seed, r));
+		MatrixSolution one = solve(alg, matrix, funs, reps, 0, budget);
+		isGood = isGood && one.messages == repeated.messages[r];
+		for (unsigned i = 0; i < count; ++i) {
+			isGood = isGood && checkError(one.primals[i],
+										  repeated.repetitions(r, i));
+		}
+	}
+	for (unsigned i = 0; i < count; ++i) {
+		std::vector<double> values;
+		for (unsigned r = 0; r < REPETITIONS; ++r) {
+			values.push_back(repeated.repetitions(r, i));
+		}
+		std::sort(values.begin(), values.end());
+		isGood = isGood && repeated.primals[i] == values[1] &&
+			least.primals[i] == values[0];
+	}
+	std::cout << "Testing repeated ranks...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Same query through the runtime-polymorphic oracle interface
+	MatrixOracle adapter(matrix);
+	const Oracle& oracle = adapter;
+	LocoSolution direct = loco(alg, matrix, funs, ranks, 0);
+	LocoSolution virt = loco(alg, oracle, funs, ranks, 0);
+	isGood = checkError(direct.primal, virt.primal) &&
+		direct.messages == virt.messages && direct.probes == virt.probes;
+	std::cout << "Testing oracle interface...\t" << (isGood ? "OK" : "FAILED")
+		<< std::endl;
+
+	// Queries over caller-owned CSC arrays must match the owning matrix
+	std::vector<int> outer(1, 0), inner;
+	std::vector<double> values;
+	for (unsigned c = 0; c < matrix.getCols(); ++c) {
+		SpVec col = matrix.getCol(c);
+		for (SpVec::InnerIterator it(col); it; ++it) {
+			inner.push_back((int)it.index());
+			values.push_back(it.value());
+		}
+		outer.push_back((int)inner.size());
+	}
+	Matrix borrowed =
+		Matrix::borrow(matrix.getRows(), matrix.getCols(), outer.data(),
+					   inner.data(), values.data(), matrix.getB());
+	isGood = true;
+	for (unsigned ind = 0; ind < 10; ++ind) {
+		LocoSolution owned = loco(alg, matrix, funs, ranks, ind);
+		LocoSolution wrapped = loco(alg, borrowed, funs, ranks, ind);
+		isGood = isGood && checkError(owned.primal, wrapped.primal) &&
+			owned.messages == wrapped.messages;
+	}
+	std::cout << "Testing borrowed matrix...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Compressed adjacency must decode to the same pattern and explore
+	// alike; it owns its values and b, so the copy it was built from goes
+	std::unique_ptr<CompressedOracle> owner;
+	{
+		Matrix copy = matrix;
+		owner.reset(new CompressedOracle(copy));
+	}
+	const CompressedOracle& compressed = *owner;
+	const CompressedPattern& pattern = compressed.getPattern();
+	isGood = pattern.getNonZeros() == matrix.getTriplets().size();
+	for (unsigned r = 0; r < matrix.getRows(); ++r) {
+		SpVec line = matrix.getRow(r);
+		SpVec::InnerIterator expected(line);
+		CompressedPattern::Iterator it = pattern.row(r);
+		for (; it && expected; ++it, ++expected) {
+			isGood = isGood && it.index() == (unsigned)expected.index();
+		}
+		isGood = isGood && !it && !expected;
+	}
+	for (unsigned c = 0; c < matrix.getCols(); ++c) {
+		SpVec line = matrix.getCol(c);
+		SpVec::InnerIterator expected(line);
+		CompressedPattern::Iterator it = pattern.col(c);
+		for (; it && expected; ++it, ++expected) {
+			isGood = isGood && it.index() == (unsigned)expected.index();
+		}
+		isGood = isGood && !it && !expected;
+	}
+	for (unsigned r = 0; r < matrix.getRows(); ++r) {
+		isGood = isGood && compressed.getB(r) == matrix.getB(r) &&
+			compressed.getRow(r).isApprox(matrix.getRow(r), 0);
+	}
+	for (unsigned c = 0; c < matrix.getCols(); ++c) {
+		isGood = isGood && compressed.getCol(c).isApprox(matrix.getCol(c), 0);
+	}
+	for (unsigned ind = 0; ind < 10; ++ind) {
+		LocoSolution plain = loco(alg, matrix, funs, ranks, ind);
+		LocoSolution packed = loco(alg, compressed, funs, ranks, ind);
+		isGood = isGood && checkError(plain.primal, packed.primal) &&
+			plain.messages == packed.messages && plain.probes == packed.probes;
+	}
+	std::cout << "Testing compressed adjacency...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Both local kernels must agree whatever the problem size
+	isGood = true;
+	for (unsigned ind = 0; ind < 10; ++ind) {
+		LocoSolution dense =
+			loco(onlineFractionalDense, matrix, funs, ranks, ind, 40 * ind);
+		LocoSolution sparse =
+			loco(onlineFractionalSparse, matrix, funs, ranks, ind, 40 * ind);
+		isGood = isGood && checkError(dense.primal, sparse.primal);
+	}
+	// 16 x (2^28 + 1) cells wrap to 16 in 32 bits; never dense
+	KernelThresholds kept = getKernelThresholds();
+	setKernelThresholds(DEFAULT_THRESHOLDS);
+	isGood = isGood && preferDense(16, 16, 256) &&
+		!preferDense(16, (1u << 28) + 1, 256);
+	setKernelThresholds(kept);
+	std::cout << "Testing dense and sparse kernels...\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Simulated deployment must explore and solve exactly like loco()
+	Cluster cluster(matrix, ranks, 4);
+	isGood = true;
+	for (unsigned ind = 0; ind < 10; ++ind) {
+		LocoSolution l = loco(alg, matrix, funs, ranks, ind);
+		DistributedSolution d = cluster.query(alg, funs, ind);
+		isGood = isGood && checkError(l.primal, d.primal) &&
+			l.messages == d.messages;
+	}
+	std::cout << "Testing distributed simulation...\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Interleaved resumable queries must match one-at-a-time loco()
+	uivector queries;
+	for (unsigned ind = 0; ind < count; ind += 7) {
+		queries.push_back(ind);
+	}
+	ImmediateSource<Matrix> source(matrix);
+	LifoScheduler scheduler;
+	std::vector<LocoSolution> async = locoAsync(
+		alg, matrix, funs, ranks, queries, source, scheduler, 8, budget);
+	isGood = true;
+	for (unsigned i = 0; i < queries.size(); ++i) {
+		LocoSolution l = loco(alg, matrix, funs, ranks, queries[i], budget);
+		isGood = isGood && checkError(l.primal, async[i].primal) &&
+			l.messages == async[i].messages && l.probes == async[i].probes &&
+			l.truncated == async[i].truncated;
+	}
+	std::cout << "Testing asynchronous queries...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Readers answer from whichever snapshot was current while a writer
+	// keeps publishing updates; each answer must match that snapshot
+	QueryService service(alg, matrix, funs, ranks, budget);
+	std::vector<std::shared_ptr<const Snapshot>> snapshots;
+	snapshots.push_back(service.getSnapshot());
+	typedef struct {
+		unsigned ind;
+		unsigned long long epoch;
+		LocoSolution solution;
+	} Answer;
+	std::vector<std::vector<Answer>> answers(4);
+	std::vector<std::thread> readers;
+	for (unsigned t = 0; t < answers.size(); ++t) {
+		readers.push_back(std::thread([&, t]() {
+			for (unsigned ind = t; ind < count; ind += 2) {
+				Answer a;
+				a.ind = ind;
+				a.solution = service.query(ind, &a.epoch);
+				answers[t].push_back(a);
+			}
+		}));
+	}
+	for (unsigned update = 0; update < 5; ++update) {
+		std::vector<T> cells;
+		for (unsigned i = 0; i < 10; ++i) {
+			cells.push_back(T((unsigned)(costs() % matrix.getRows()),
+							  (unsigned)(costs() % matrix.getCols()),
+							  costs.uniform()));
+		}
+		service.updateCells(cells);
+		snapshots.push_back(service.getSnapshot());
+	}
+	for (std::thread& t : readers) {
+		t.join();
+	}
+	isGood = service.getEpoch() == 5;
+	for (auto& list : answers) {
+		for (Answer& a : list) {
+			const Snapshot& s = *snapshots[a.epoch];
+			LocoSolution l =
+				loco(alg, *s.matrix, *s.funs, *s.ranks, a.ind, budget);
+			isGood = isGood && checkError(l.primal, a.solution.primal) &&
+				l.messages == a.solution.messages;
+		}
+	}
+	std::cout << "Testing snapshot service...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Repeated queries hit the cache; after updates, every answer must
+	// match a fresh solve of the current snapshot
+	QueryService cached(alg, matrix, funs, ranks, budget, count);
+	for (unsigned pass = 0; pass < 2; ++pass) {
+		for (unsigned ind = 0; ind < count; ++ind) {
+			cached.query(ind);
+		}
+	}
+	isGood = cached.getCache()->getHits() == count;
+	std::vector<T> cells;
+	for (unsigned i = 0; i < 3; ++i) {
+		cells.push_back(T((unsigned)(costs() % matrix.getRows()),
+						  (unsigned)(costs() % matrix.getCols()),
+						  costs.uniform()));
+	}
+	cached.updateCells(cells);
+	std::shared_ptr<const Snapshot> before = cached.getSnapshot();
+	cached.updateFunction(0, [](double x) { return 2 * x * x; });
+	std::shared_ptr<const Snapshot> latest = cached.getSnapshot();
+	// Only the functions were copied; the rest is shared
+	isGood = isGood && latest->matrix == before->matrix &&
+		latest->ranks == before->ranks && latest->funs != before->funs;
+	for (unsigned ind = 0; ind < count; ++ind) {
+		LocoSolution c = cached.query(ind);
+		LocoSolution l = loco(alg, *latest->matrix, *latest->funs,
+							  *latest->ranks, ind, budget);
+		isGood = isGood && checkError(l.primal, c.primal) &&
+			l.messages == c.messages;
+	}
+	cached.updateRanks(generateRanks(matrix.getRows(), seed + 1));
+	isGood = isGood && cached.getCache()->getSize() == 0;
+	std::cout << "Testing solution cache...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// Only queries sending at least the median messages are kept, each
+	// with one event per probe made while exploring
+	uivector sent = s.actual;
+	std::sort(sent.begin(), sent.end());
+	unsigned median = sent[count / 2];
+	TraceThresholds slow = { 1e9, median, 1u << 30, count };
+	startTracing(slow);
+	std::vector<LocoSolution> traced;
+	for (unsigned ind = 0; ind < count; ++ind) {
+		traced.push_back(loco(alg, matrix, funs, ranks, ind, UNLIMITED));
+	}
+	stopTracing();
+	std::vector<QueryTraceData> traces = collectTraces();
+	unsigned slowQueries = 0;
+	for (const LocoSolution& l : traced) {
+		slowQueries += l.messages >= median;
+	}
+	isGood = traces.size() == slowQueries && slowQueries > 0;
+	for (const QueryTraceData& t : traces) {
+		const LocoSolution& l = traced[t.ind];
+		isGood = isGood && t.messages == l.messages && t.dropped == 0 &&
+			t.events.size() + 1 + t.cols == l.probes;
+	}
+	std::ostringstream chrome;
+	writeChromeTrace(chrome, traces);
+	isGood = isGood && chrome.str().find("{\"traceEvents\":[") == 0;
+	std::cout << "Testing exploration trace...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+
+	// The reference solve brackets the optimum to within its tolerance with
+	// a feasible point, and no feasible answer beats its lower bound
+	ReferenceSettings settings = DEFAULT_REFERENCE;
+	settings.tolerance = 1e-3;
+	ReferenceSolution reference = solveReference(matrix, funs, settings);
+	CoverQuality best = evaluateCover(matrix, funs, reference.primals);
+	CoverQuality online = evaluateCover(matrix, funs, s.primals);
+	isGood = best.violated == 0 &&
+		fabs(best.objective - reference.objective) <=
+			1e-9 * reference.objective &&
+		reference.objective - reference.lowerBound <=
+			settings.tolerance * reference.objective &&
+		(online.violated > 0 || online.objective >= reference.lowerBound);
+	std::cout << "Testing reference solver...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+	std::cout << "Reference objective " << reference.objective << " after "
+		<< reference.iterations << " iterations; LOCO " << online.objective
+		<< " (ratio " << online.objective / reference.objective << "), "
+		<< online.violated << " rows uncovered" << std::endl;
+
+	// Queries on a 10^9 x 10^9 instance generated only where it is probed
+	const unsigned HUGE_SIZE = 1000000000, HUGE_BUDGET = 2000;
+	ImplicitMatrix huge(HUGE_SIZE, HUGE_SIZE, seed);
+	ImplicitRanks hugeRanks(HUGE_SIZE, seed);
+	ImplicitFunctions hugeFuns(HUGE_SIZE, [](unsigned j) {
+		double c = 0.5 + (j % 2) * 0.25;
+		return [c](double x) { return c * x * x; };
+	});
+	// Entries are pure functions of the seed: another instance probed in
+	// another order first answers every query the same
+	ImplicitMatrix again(HUGE_SIZE, HUGE_SIZE, seed);
+	again.getRow(HUGE_SIZE - 1);
+	again.getCol(12345);
+	const unsigned hugeInd[] = { 0u, 12345u, HUGE_SIZE - 1 };
+	LocoSolution hugeAnswers[3];
+	for (unsigned i = 0; i < 3; ++i) {
+		hugeAnswers[i] =
+			loco(alg, huge, hugeFuns, hugeRanks, hugeInd[i], HUGE_BUDGET);
+	}
+	// Column ind is local column 0 and lies on the root row, which the
+	// kernel covers, so every queried primal is positive
+	isGood = true;
+	for (unsigned i = 3; i-- > 0;) {
+		LocoSolution h =
+			loco(alg, again, hugeFuns, hugeRanks, hugeInd[i], HUGE_BUDGET);
+		isGood = isGood && hugeAnswers[i].primal > 0 &&
+			h.primal == hugeAnswers[i].primal &&
+			h.messages == hugeAnswers[i].messages;
+	}
+	std::cout << "Testing implicit instance...\t\t"
+		<< (isGood ? "OK" : "FAILED") << std::endl;
+	for (unsigned i = 0; i < 3; ++i) {
+		const LocoSolution& h = hugeAnswers[i];
+		std::cout << "Implicit x_" << hugeInd[i] << " = " << h.primal
+			<< ", messages " << h.messages
+			<< (h.truncated ? " (truncated)" : "") << std::endl;
+	}
 
 	std::cout << "Press [Enter] to quit...\n" << std::endl;
 	std::cin.get();
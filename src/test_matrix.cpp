@@ -1,3 +1,5 @@
+#include "build.hpp"
+#include "generators.hpp"
 #include "matrix.hpp"
 
 const unsigned SIZE = 10;
@@ -5,7 +7,7 @@ const unsigned M = 15;
 const unsigned N = 20;
 const double P = 5 / (double)N;
 
-void testMatrix(Matrix* m) {
+void testMatrix(Matrix* m, RandomStream& picks) {
 	bool isGood;
 	std::cout << "Checking each row for nonzero...\t";
 	int badRow = -1;
@@ -72,13 +74,16 @@ void testMatrix(Matrix* m) {
 
 	isGood = true;
 	std::cout << "Testing submatrix...\t\t\t";
+	// Distinct random rows and columns
+	Permutation rowPicks(m->getRows(), picks());
+	Permutation colPicks(m->getCols(), picks());
 	uivector rows;
 	for (int i = (int)sqrt(m->getRows()) - 1; i >= 0; --i) {
-		rows.push_back(rand() % m->getRows());
+		rows.push_back((unsigned)rowPicks(i));
 	}
 	uivector cols;
 	for (int i = (int)sqrt(m->getCols()) - 1; i >= 0; --i) {
-		cols.push_back(rand() % m->getCols());
+		cols.push_back((unsigned)colPicks(i));
 	}
 	Matrix sub = m->getSubmatrix(rows, cols);
 	for (unsigned i = 0; i < rows.size(); ++i) {
@@ -92,6 +97,28 @@ void testMatrix(Matrix* m) {
 	}
 	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
 
+	isGood = true;
+	std::cout << "Testing submatrix view...\t\t";
+	{
+		ArenaScope scope(queryArena());
+		MatrixView view = m->getView(rows, cols);
+		for (unsigned j = 0; j < cols.size() && isGood; ++j) {
+			for (unsigned i = 0; i < rows.size(); ++i) {
+				if (!checkError(view.getCell(i, j),
+								m->getCell(rows[i], cols[j]))) {
+					isGood = false;
+				}
+			}
+			for (MatrixView::ColIterator it(view, j); it; ++it) {
+				if (!checkError(it.value(),
+								m->getCell(rows[it.row()], cols[j]))) {
+					isGood = false;
+				}
+			}
+		}
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
 	std::cout << "Printing submatrix..." << std::endl;
 	sub.printDense();
 
@@ -104,20 +131,293 @@ void testMatrix(Matrix* m) {
 	std::cout << std::endl << std::endl;
 }
 
-int main() {
+int main(int argc, char* argv[]) {
+	// Same seed, same run: pass one to reproduce a previous run
+	uint64_t seed = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : clockSeed();
+	std::cout << "Seed: " << seed << std::endl;
+	RandomStream picks(seed, 0);
+
 	Matrix* mDefault = new Matrix;
-	Matrix* mSize = new Matrix(SIZE);
-	Matrix* mMN = new Matrix(M, N, P);
+	Matrix* mSize = new Matrix(Matrix::seeded(SIZE, SIZE, seed));
+	Matrix* mMN = new Matrix(M, N, P, DEFAULT_NOISE, seed);
 
 	// std::cout << "Testing default matrix..." << std::endl << std::endl;
 	// testMatrix(mDefault);
 	std::cout << "Testing size " << SIZE << " matrix..." << std::endl
 		<< std::endl;
-	testMatrix(mSize);
+	testMatrix(mSize, picks);
 	std::cout << "Testing " << M << "x" << N << " matrix, sparcity " << P
 		<< "..." << std::endl
 		<< std::endl;
-	testMatrix(mMN);
+	testMatrix(mMN, picks);
+
+	std::cout << "Testing batch set cells...\t\t";
+	Matrix batch(M, N, P, DEFAULT_NOISE, seed);
+	Matrix single = batch;
+	std::vector<T> updates;
+	for (unsigned i = 0; i < M; ++i) {
+		double value = i % 3 == 0 ? 0 : 0.5 + i;
+		updates.push_back(T(i, (i * 7) % N, value));
+		single.setCell(i, (i * 7) % N, value);
+	}
+	batch.setCells(updates);
+	bool isGood = true;
+	for (unsigned i = 0; i < batch.getCells(); ++i) {
+		isGood = isGood && batch.getCell(i) == single.getCell(i) &&
+			batch.isOccupied(i) == single.isOccupied(i);
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing borrowed storage...\t\t";
+	Matrix source(M, N, P, DEFAULT_NOISE, seed);
+	std::vector<int> outer(1, 0), inner;
+	std::vector<double> values;
+	for (unsigned c = 0; c < N; ++c) {
+		SpVec col = source.getCol(c);
+		for (SpVec::InnerIterator it(col); it; ++it) {
+			inner.push_back((int)it.index());
+			values.push_back(it.value());
+		}
+		outer.push_back((int)inner.size());
+	}
+	Matrix borrowed = Matrix::borrow(M, N, outer.data(), inner.data(),
+									 values.data(), source.getB());
+	isGood = borrowed.isBorrowed() && borrowed.getB() == source.getB();
+	for (unsigned i = 0; i < source.getCells(); ++i) {
+		isGood = isGood && borrowed.getCell(i) == source.getCell(i) &&
+			borrowed.isOccupied(i) == source.isOccupied(i);
+	}
+	// The CSR arrays of the same entries serve row probes in place
+	std::vector<int> rowOuter(1, 0), rowInner;
+	std::vector<double> rowValues;
+	for (unsigned r = 0; r < M; ++r) {
+		SpVec row = source.getRow(r);
+		for (SpVec::InnerIterator it(row); it; ++it) {
+			rowInner.push_back((int)it.index());
+			rowValues.push_back(it.value());
+		}
+		rowOuter.push_back((int)rowInner.size());
+	}
+	Matrix byRows = Matrix::borrow(M, N, outer.data(), inner.data(),
+								   values.data(), source.getB(),
+								   rowOuter.data(), rowInner.data(),
+								   rowValues.data());
+	for (unsigned r = 0; r < M; ++r) {
+		isGood = isGood && borrowed.getRow(r).isApprox(source.getRow(r)) &&
+			byRows.getRow(r).isApprox(source.getRow(r));
+	}
+	// No row index while borrowed; writes copy out first, build the
+	// deferred index and leave the caller's arrays alone
+	borrowed.buildRowIndex();
+	isGood = isGood && borrowed.getMemory().rowMajor == 0;
+	std::vector<double> before = values;
+	borrowed.setCell(0, 0, 42);
+	isGood = isGood && !borrowed.isBorrowed() && values == before &&
+		borrowed.getCell(0, 0) == 42 &&
+		borrowed.getCell(1) == source.getCell(1) &&
+		borrowed.getMemory().rowMajor > 0 && borrowed.getRow(0).coeff(0) == 42;
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing memory accounting...\t\t";
+	size_t arrays = outer.size() * sizeof(int) +
+		inner.size() * (sizeof(int) + sizeof(double));
+	Matrix wrapped = Matrix::borrow(M, N, outer.data(), inner.data(),
+									values.data(), source.getB());
+	MatrixMemory shared = wrapped.getMemory();
+	MatrixMemory owned = source.getMemory();
+	isGood = shared.borrowed == arrays && shared.storage < arrays &&
+		shared.rowMajor == 0 && owned.borrowed == 0 &&
+		owned.storage >= arrays && owned.rhs == M * sizeof(double);
+	// What a borrowed matrix owns does not grow with its nonzeros
+	std::vector<int> firstOuter(1, 0), firstInner;
+	std::vector<double> firstValues;
+	for (unsigned c = 0; c < N; ++c) {
+		if (outer[c] < outer[c + 1]) {
+			firstInner.push_back(inner[outer[c]]);
+			firstValues.push_back(values[outer[c]]);
+		}
+		firstOuter.push_back((int)firstInner.size());
+	}
+	MatrixMemory fewer = Matrix::borrow(M, N, firstOuter.data(),
+										firstInner.data(), firstValues.data(),
+										source.getB()).getMemory();
+	MatrixMemory rowsToo = byRows.getMemory();
+	isGood = isGood && firstInner.size() < inner.size() &&
+		shared.storage + shared.degrees == fewer.storage + fewer.degrees &&
+		rowsToo.storage + rowsToo.degrees + rowsToo.rowMajor ==
+			fewer.storage + fewer.degrees &&
+		rowsToo.borrowed == arrays + rowOuter.size() * sizeof(int) +
+			rowInner.size() * (sizeof(int) + sizeof(double));
+	wrapped.setCell(0, 0, 1);
+	isGood = isGood && wrapped.getMemory().borrowed == 0 &&
+		wrapped.getMemory().storage >= arrays;
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing skewed generators...\t\t";
+	const unsigned R = 60, C = 40;
+	std::vector<Matrix> serial, parallel;
+	serial.push_back(powerLawMatrix(R, C, 3, 2.5, seed, 1));
+	parallel.push_back(powerLawMatrix(R, C, 3, 2.5, seed, 3));
+	serial.push_back(blockMatrix(R, C, 4, 0.3, 0.01, seed, 1));
+	parallel.push_back(blockMatrix(R, C, 4, 0.3, 0.01, seed, 3));
+	serial.push_back(bandedMatrix(R, C, 2, seed, 1));
+	parallel.push_back(bandedMatrix(R, C, 2, seed, 3));
+	serial.push_back(preferentialMatrix(R, C, 3, seed));
+	parallel.push_back(preferentialMatrix(R, C, 3, seed));
+	isGood = true;
+	for (unsigned r = 0; r < R; ++r) {
+		isGood = isGood && serial[0].getRowDegree(r) > 0;  // Anchored rows
+	}
+	for (unsigned g = 0; g < serial.size(); ++g) {
+		isGood = isGood && serial[g].getB() == parallel[g].getB();
+		for (unsigned i = 0; i < serial[g].getCells(); ++i) {
+			isGood = isGood && serial[g].getCell(i) == parallel[g].getCell(i);
+		}
+		for (unsigned c = 0; c < C; ++c) {
+			isGood = isGood && serial[g].getCol(c).nonZeros() > 0;
+		}
+	}
+	for (unsigned c = 0; c < C; ++c) {
+		unsigned diagonal = c * R / C;
+		for (unsigned r = 0; r < R; ++r) {
+			bool inBand = r + 2 >= diagonal && r <= diagonal + 2;
+			isGood = isGood && serial[2].isOccupied(r, c) == inBand;
+		}
+		isGood = isGood && serial[3].getCol(c).nonZeros() == 3;
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing parallel construction...\t";
+	const unsigned BULK = 1 << 19;  // Enough triplets for several threads
+	std::vector<T> bulk;
+	std::map<std::pair<int, int>, double> last;
+	for (unsigned i = 0; i < BULK; ++i) {
+		T t((int)(picks() % R), (int)(picks() % C), picks.uniform());
+		bulk.push_back(t);
+		last[std::make_pair(t.row(), t.col())] = t.value();
+	}
+	SpMat reference(R, C), summed, kept;
+	reference.setFromTriplets(bulk.begin(), bulk.end());
+	SpMatR rowMajor;
+	buildSparse(R, C, bulk, summed, &rowMajor, DUPLICATES_SUM, 4);
+	buildSparse(R, C, bulk, kept, nullptr, DUPLICATES_LAST, 4);
+	SpMatR referenceRows(reference);
+	isGood = summed.nonZeros() == reference.nonZeros() &&
+		rowMajor.nonZeros() == reference.nonZeros() &&
+		kept.nonZeros() == (long)last.size();
+	for (unsigned i = 0; isGood && i < reference.nonZeros(); ++i) {
+		isGood = summed.innerIndexPtr()[i] == reference.innerIndexPtr()[i] &&
+			summed.valuePtr()[i] == reference.valuePtr()[i] &&
+			rowMajor.innerIndexPtr()[i] == referenceRows.innerIndexPtr()[i] &&
+			rowMajor.valuePtr()[i] == referenceRows.valuePtr()[i];
+	}
+	Matrix built(R, C, bulk, DVec::Zero(R), DUPLICATES_LAST, 4);
+	for (auto& cell : last) {
+		int r = cell.first.first, c = cell.first.second;
+		isGood = isGood && kept.coeff(r, c) == cell.second &&
+			built.getCell(r, c) == cell.second;
+	}
+	// Far more columns than triplets per thread: all 8 threads still run
+	const unsigned WIDE = 1 << 22;
+	std::vector<T> wide;
+	for (unsigned i = 0; i < BULK; ++i) {
+		wide.push_back(T((int)(picks() % R), (int)(picks() % WIDE),
+						 picks.uniform()));
+	}
+	SpMat wideReference(R, WIDE), wideBuilt;
+	wideReference.setFromTriplets(wide.begin(), wide.end());
+	buildSparse(R, WIDE, wide, wideBuilt, nullptr, DUPLICATES_SUM, 8);
+	isGood = isGood && wideBuilt.nonZeros() == wideReference.nonZeros();
+	for (unsigned c = 0; isGood && c <= WIDE; ++c) {
+		isGood = wideBuilt.outerIndexPtr()[c] ==
+			wideReference.outerIndexPtr()[c];
+	}
+	for (unsigned i = 0; isGood && i < wideReference.nonZeros(); ++i) {
+		isGood = wideBuilt.innerIndexPtr()[i] ==
+				wideReference.innerIndexPtr()[i] &&
+			wideBuilt.valuePtr()[i] == wideReference.valuePtr()[i];
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing structural statistics...\t";
+	auto degreesMatch = [](const Matrix& m) {
+		std::vector<unsigned> rowCount(m.getRows(), 0);
+		unsigned maxRow = 0, maxCol = 0;
+		bool match = true;
+		for (unsigned c = 0; c < m.getCols(); ++c) {
+			unsigned colCount = 0;
+			for (unsigned r = 0; r < m.getRows(); ++r) {
+				bool occupied = m.getCell(r, c) != 0;
+				match = match && m.isOccupied(r, c) == occupied;
+				colCount += occupied;
+				rowCount[r] += occupied;
+			}
+			match = match && m.getColDegree(c) == colCount;
+			maxCol = std::max(maxCol, colCount);
+		}
+		for (unsigned r = 0; r < m.getRows(); ++r) {
+			SpVec row = m.getRow(r);
+			match = match && m.getRowDegree(r) == rowCount[r] &&
+				row.nonZeros() == rowCount[r];
+			for (SpVec::InnerIterator it(row); it; ++it) {
+				match = match && it.value() == m.getCell(r, it.index());
+			}
+			maxRow = std::max(maxRow, rowCount[r]);
+		}
+		return match && m.getMaxRowDegree() == maxRow &&
+			m.getMaxColDegree() == maxCol;
+	};
+	Matrix stats(M, N, P, DEFAULT_NOISE, seed);
+	isGood = degreesMatch(stats) && degreesMatch(borrowed) &&
+		degreesMatch(built) && degreesMatch(serial[0]) &&
+		stats.getMemory().rowMajor == 0;
+	Matrix indexed = stats;  // Row probes through the row-major copy
+	indexed.buildRowIndex();
+	isGood = isGood && indexed.getMemory().rowMajor > 0;
+	for (Matrix* m : {&stats, &indexed}) {
+		for (unsigned i = 0; i < m->getCells(); ++i) {
+			if (!m->isOccupied(i)) {
+				m->setCell(i, 0.5);   // Grow a row and a column
+				m->setCell(i, 0.75);  // Then change a stored value
+				break;
+			}
+		}
+		isGood = isGood && degreesMatch(*m);
+		m->setCell(0, 0, 0);
+		m->clearCell(M - 1, N - 1);
+		isGood = isGood && degreesMatch(*m);
+		m->setCells(updates);
+		isGood = isGood && degreesMatch(*m);
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	// The last row, column and cell are the boundary the checks let
+	// through; one past them exits with checkRow/checkCol/checkInd ERROR
+	std::cout << "Testing boundary indices...\t\t";
+	Matrix edge(M, N, P, DEFAULT_NOISE, seed);
+	edge.clearCell(M - 1, N - 1);
+	unsigned lastRow = edge.getRowDegree(M - 1);
+	unsigned lastCol = edge.getColDegree(N - 1);
+	isGood = !edge.isOccupied(M - 1, N - 1) &&
+		!edge.isOccupied(edge.getCells() - 1) &&
+		lastRow == edge.getRow(M - 1).nonZeros() &&
+		lastCol == edge.getCol(N - 1).nonZeros();
+	edge.setCell(M - 1, N - 1, 0.5);
+	isGood = isGood && edge.isOccupied(M - 1, N - 1) &&
+		edge.isOccupied(edge.getCells() - 1) &&
+		edge.getCell(edge.getCells() - 1) == 0.5 &&
+		edge.getRowDegree(M - 1) == lastRow + 1 &&
+		edge.getColDegree(N - 1) == lastCol + 1;
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
+
+	std::cout << "Testing seeded generation...\t\t";
+	Matrix first(M, N, P, DEFAULT_NOISE, seed);
+	Matrix again(M, N, P, DEFAULT_NOISE, seed);
+	isGood = again.getB() == first.getB();
+	for (unsigned i = 0; i < first.getCells(); ++i) {
+		isGood = isGood && again.getCell(i) == first.getCell(i);
+	}
+	std::cout << (isGood ? "OK" : "FAILED") << std::endl;
 
 	delete mDefault;
 	delete mSize;
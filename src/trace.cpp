@@ -0,0 +1,155 @@
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "trace.hpp"
+
+// Set while tracing; the thresholds only change while it is clear
+static std::atomic<bool> tracing(false);
+static std::chrono::steady_clock::time_point traceEpoch;
+
+// Queries read the thresholds through this pointer without locking, so
+// every snapshot published stays alive: one small struct per restart
+static const TraceThresholds defaultThresholds = DEFAULT_TRACE;
+static std::atomic<const TraceThresholds*> publishedThresholds(
+	&defaultThresholds);
+static std::vector<std::unique_ptr<const TraceThresholds>> allThresholds;
+
+// Guards the kept traces, the epoch and the snapshots above
+static std::mutex traceLock;
+static std::vector<QueryTraceData> keptTraces;
+
+static unsigned threadId() {
+	static std::atomic<unsigned> next(0);
+	static thread_local unsigned id = next++;
+	return id;
+}
+
+void startTracing(TraceThresholds t) {
+	tracing.store(false);
+	{
+		std::lock_guard<std::mutex> guard(traceLock);
+		keptTraces.clear();
+		allThresholds.push_back(
+			std::unique_ptr<const TraceThresholds>(new TraceThresholds(t)));
+		publishedThresholds.store(allThresholds.back().get(),
+								  std::memory_order_release);
+		traceEpoch = std::chrono::steady_clock::now();
+	}
+	tracing.store(true);
+}
+
+void stopTracing() {
+	tracing.store(false);
+}
+
+bool tracingEnabled() {
+	return tracing.load(std::memory_order_relaxed);
+}
+
+std::vector<QueryTraceData> collectTraces() {
+	std::lock_guard<std::mutex> guard(traceLock);
+	return keptTraces;
+}
+
+static QueryTraceData& threadTrace() {
+	static thread_local QueryTraceData data;
+	return data;
+}
+
+QueryTrace::QueryTrace(unsigned ind)
+	: active(tracing.load(std::memory_order_acquire)),
+	  data(threadTrace()),
+	  levelEnd(0) {
+	if (!active) {
+		return;
+	}
+	// A snapshot startTracing() never changes; only keeping a trace locks
+	thresholds = *publishedThresholds.load(std::memory_order_acquire);
+	start = Clock::now();
+	data.ind = ind;
+	data.root = 0;
+	data.thread = threadId();
+	data.messages = 0;
+	data.truncated = false;
+	data.layers = 0;
+	data.rows = data.cols = 0;
+	data.dropped = 0;
+	data.events.clear();  // Keeps capacity from earlier queries
+}
+
+QueryTrace::~QueryTrace() {
+	if (!active) {
+		return;
+	}
+	Clock::time_point end = Clock::now();
+	data.duration = (uint64_t)std::chrono::duration_cast<
+						std::chrono::nanoseconds>(end - start)
+						.count();
+	if (data.duration < thresholds.seconds * 1e9 &&
+		data.messages < thresholds.messages) {
+		return;
+	}
+	std::lock_guard<std::mutex> guard(traceLock);
+	if (keptTraces.size() >= thresholds.maxQueries ||
+		start < traceEpoch) {
+		return;  // Full, or started before tracing was restarted
+	}
+	data.start = (uint64_t)std::chrono::duration_cast<
+					 std::chrono::nanoseconds>(start - traceEpoch)
+					 .count();
+	keptTraces.push_back(data);
+}
+
+// Chrome timestamps are microseconds
+static double micros(uint64_t ns) {
+	return ns / 1000.0;
+}
+
+void writeChromeTrace(std::ostream& out,
+					  const std::vector<QueryTraceData>& traces) {
+	out << "{\"traceEvents\":[";
+	bool first = true;
+	for (const QueryTraceData& t : traces) {
+		out << (first ? "" : ",") << "\n{\"name\":\"query " << t.ind
+			<< "\",\"cat\":\"loco\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+			<< t.thread << ",\"ts\":" << micros(t.start)
+			<< ",\"dur\":" << micros(t.duration) << ",\"args\":{\"primal\":"
+			<< t.ind << ",\"root\":" << t.root << ",\"messages\":"
+			<< t.messages << ",\"truncated\":"
+			<< (t.truncated ? "true" : "false") << ",\"layers\":" << t.layers
+			<< ",\"rows\":" << t.rows << ",\"cols\":" << t.cols
+			<< ",\"dropped\":" << t.dropped << "}}";
+		first = false;
+
+		// An expansion lasts until the next one, or until the BFS ended
+		uint64_t bfsEnd = t.events.empty() ? 0 : t.events.back().time;
+		for (size_t i = 0; i < t.events.size(); ++i) {
+			const TraceEvent& e = t.events[i];
+			uint64_t ts = t.start + e.time;
+			if (e.type == TRACE_EXPAND) {
+				uint64_t next = bfsEnd;
+				for (size_t j = i + 1; j < t.events.size(); ++j) {
+					if (t.events[j].type == TRACE_EXPAND) {
+						next = t.events[j].time;
+						break;
+					}
+				}
+				out << ",\n{\"name\":\"expand " << e.index
+					<< "\",\"cat\":\"bfs\",\"ph\":\"X\",\"pid\":1,\"tid\":"
+					<< t.thread << ",\"ts\":" << micros(ts) << ",\"dur\":"
+					<< micros(next - e.time) << ",\"args\":{\"dual\":"
+					<< e.index << ",\"rank\":" << e.rank
+					<< ",\"layer\":" << e.from << "}}";
+			} else {
+				out << ",\n{\"name\":\"probe " << e.index
+					<< "\",\"cat\":\"probe\",\"ph\":\"i\",\"s\":\"t\","
+					<< "\"pid\":1,\"tid\":" << t.thread << ",\"ts\":"
+					<< micros(ts) << ",\"args\":{\"primal\":" << e.index
+					<< ",\"from\":" << e.from << ",\"fromRank\":" << e.rank
+					<< ",\"admitted\":" << (e.admitted ? "true" : "false")
+					<< "}}";
+			}
+		}
+	}
+	out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+}
@@ -0,0 +1,131 @@
+#ifndef TRACE_HPP
+#define TRACE_HPP
+
+// Includes
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+/**
+ * Exploration traces of slow loco() queries
+ * Off until startTracing(). While on, every query records its exploration
+ * into a per-thread buffer of at most maxEvents events (later ones are
+ * counted, not kept), and the trace is kept only if the query took at
+ * least the given time or sent at least the given messages, up to
+ * maxQueries traces. Off, each hook is one predictable branch.
+ */
+
+typedef struct {
+	double seconds;       // Keep queries at least this slow...
+	unsigned messages;    // ...or sending at least this many messages
+	unsigned maxEvents;   // Per query
+	unsigned maxQueries;  // Kept in total
+} TraceThresholds;
+const TraceThresholds DEFAULT_TRACE = { 0.1, 100000, 1 << 16, 64 };
+
+enum TraceType {
+	TRACE_EXPAND,  // Row of a dual taken from the BFS queue and probed
+	TRACE_PROBE    // Column of a primal on that row probed
+};
+
+typedef struct {
+	uint8_t type;      // TraceType
+	bool admitted;     // PROBE: rank comparison let a dual into X_k
+	unsigned index;    // Dual expanded, or primal probed
+	unsigned from;     // PROBE: dual whose row led to it; EXPAND: layer
+	uint64_t time;     // Nanoseconds since the query started
+	float rank;        // Rank of the dual: index, or from for PROBE
+} TraceEvent;
+
+typedef struct {
+	unsigned ind;         // Primal queried
+	unsigned root;        // Dual chosen by maxRank
+	unsigned thread;      // Small id of the thread that ran it
+	uint64_t start;       // Nanoseconds since startTracing
+	uint64_t duration;    // Nanoseconds
+	unsigned messages;
+	bool truncated;
+	unsigned layers;      // BFS levels
+	unsigned rows, cols;  // Local problem dimensions
+	unsigned dropped;     // Events beyond maxEvents
+	std::vector<TraceEvent> events;
+} QueryTraceData;
+
+void startTracing(TraceThresholds t = DEFAULT_TRACE);
+void stopTracing();
+bool tracingEnabled();
+// Traces kept since tracing started
+std::vector<QueryTraceData> collectTraces();
+// Chrome trace-event JSON (chrome://tracing, Perfetto): each query is a
+// slice with BFS expansions nested in it and probes as instant events
+void writeChromeTrace(std::ostream& out,
+					  const std::vector<QueryTraceData>& traces);
+
+// Records one query; kept by the destructor if it crossed a threshold
+class QueryTrace {
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	bool active;
+	Clock::time_point start;
+	QueryTraceData& data;  // Per-thread buffer, reused across queries
+	TraceThresholds thresholds;  // Copied at the start of the query
+	unsigned levelEnd;
+
+	uint64_t now() const {
+		return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+				   Clock::now() - start)
+			.count();
+	}
+	void add(TraceType type, bool admitted, unsigned index, unsigned from,
+			 double rank) {
+		if (data.events.size() >= thresholds.maxEvents) {
+			++data.dropped;
+			return;
+		}
+		TraceEvent e = { (uint8_t)type, admitted, index, from, now(),
+						 (float)rank };
+		data.events.push_back(e);
+	}
+
+public:
+	QueryTrace(unsigned ind);
+	~QueryTrace();
+
+	bool isActive() const {
+		return active;
+	}
+	void root(unsigned k) {
+		if (active) {
+			data.root = k;
+		}
+	}
+	// BFS takes dual k at queue position curr of a queue currently end long
+	void expand(unsigned k, double rank, unsigned curr, unsigned end) {
+		if (!active) {
+			return;
+		}
+		if (curr >= levelEnd) {
+			++data.layers;
+			levelEnd = end;
+		}
+		add(TRACE_EXPAND, false, k, data.layers, rank);
+	}
+	void probe(unsigned y0, unsigned k, double kRank, bool admitted) {
+		if (active) {
+			add(TRACE_PROBE, admitted, y0, k, kRank);
+		}
+	}
+	void done(unsigned messages, bool truncated, unsigned rows,
+			  unsigned cols) {
+		if (active) {
+			data.messages = messages;
+			data.truncated = truncated;
+			data.rows = rows;
+			data.cols = cols;
+		}
+	}
+};
+
+#endif  // TRACE_HPP